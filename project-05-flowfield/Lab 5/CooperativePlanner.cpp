@@ -0,0 +1,306 @@
+#include "CooperativePlanner.h"
+#include "Flowfield.h"
+#include <algorithm>
+
+CooperativePlanner::CooperativePlanner(const FlowField& flowField, int window)
+    : flowField(flowField), window(std::max(2, window)),
+      width(flowField.getGridWidth()), height(flowField.getGridHeight())
+{
+}
+
+int CooperativePlanner::addAgent(sf::Vector2i tile)
+{
+    if (tile.x < 0 || tile.x >= width || tile.y < 0 || tile.y >= height)
+        return -1;
+
+    int index = tile.y * width + tile.x;
+    if (getGoalCost(index) < 0)
+        return -1;
+
+    for (const Agent& agent : agents)
+    {
+        if (!agent.arrived && agent.tile == index)
+            return -1;
+    }
+
+    Agent agent;
+    agent.tile = index;
+    agent.planTick = tick;
+
+    if (getGoalCost(index) == 0)
+    {
+        agent.arrived = true;
+        stats.arrived++;
+    }
+
+    agents.push_back(std::move(agent));
+    int agentIndex = static_cast<int>(agents.size()) - 1;
+
+    // Park on the start tile until the agent has planned, or agents planning before it walk into it
+    if (!agents[agentIndex].arrived)
+    {
+        park(agentIndex, index, tick);
+    }
+
+    return agentIndex;
+}
+
+void CooperativePlanner::clearAgents()
+{
+    agents.clear();
+    reservations.clear();
+    parked.clear();
+}
+
+void CooperativePlanner::update()
+{
+    int agentCount = static_cast<int>(agents.size());
+    int replanInterval = std::max(1, window / 2);
+
+    // Planning order rotates every tick, so the agent planning first (and getting first pick of
+    // the tiles) changes all the time
+    for (int order = 0; order < agentCount; order++)
+    {
+        int agentIndex = (order + tick) % agentCount;
+        const Agent& agent = agents[agentIndex];
+
+        if (agent.arrived)
+            continue;
+
+        int remainingSteps = static_cast<int>(agent.path.size()) - (tick - agent.planTick);
+        if (remainingSteps <= 0 || (tick + agentIndex) % replanInterval == 0)
+        {
+            plan(agentIndex);
+        }
+    }
+
+    for (int agentIndex = 0; agentIndex < agentCount; agentIndex++)
+    {
+        Agent& agent = agents[agentIndex];
+        if (agent.arrived)
+            continue;
+
+        size_t step = static_cast<size_t>(tick - agent.planTick);
+        int nextTile = step < agent.path.size() ? agent.path[step] : agent.tile;
+
+        if (nextTile == agent.tile)
+        {
+            stats.waits++;
+        }
+        agent.tile = nextTile;
+
+        // Arrived agents leave the grid, their tiles are free for everyone behind them
+        if (getGoalCost(agent.tile) == 0)
+        {
+            releaseReservations(agentIndex);
+            agent.arrived = true;
+            agent.path.clear();
+            stats.arrived++;
+        }
+    }
+
+    tick++;
+}
+
+int CooperativePlanner::getAgentCount() const
+{
+    return static_cast<int>(agents.size());
+}
+
+sf::Vector2i CooperativePlanner::getAgentTile(int agent) const
+{
+    return sf::Vector2i(agents[agent].tile % width, agents[agent].tile / width);
+}
+
+bool CooperativePlanner::hasArrived(int agent) const
+{
+    return agents[agent].arrived;
+}
+
+int CooperativePlanner::getTick() const
+{
+    return tick;
+}
+
+const CooperativePlanner::Stats& CooperativePlanner::getStats() const
+{
+    return stats;
+}
+
+void CooperativePlanner::plan(int agentIndex)
+{
+    Agent& agent = agents[agentIndex];
+    releaseReservations(agentIndex);
+    stats.replans++;
+
+    nodes.clear();
+    bestNode.clear();
+    openNodes = decltype(openNodes)();
+
+    nodes.push_back({ agent.tile, 0, 0, -1 });
+    bestNode[reservationKey(agent.tile, 0)] = 0;
+    openNodes.push({ getGoalCost(agent.tile), 0 });
+
+    // A* through space and time. The search stops at the goal or at the end of the window, where
+    // the heuristic stands in for the rest of the way. The rest of the previous plan is still free,
+    // so some route always lasts the whole window.
+    int finalNode = 0;
+
+    while (!openNodes.empty())
+    {
+        int nodeIndex = openNodes.top().second;
+        openNodes.pop();
+
+        SearchNode node = nodes[nodeIndex];
+        if (bestNode[reservationKey(node.tile, node.time)] != nodeIndex)
+            continue;
+
+        stats.nodesExpanded++;
+
+        if (node.time == window || getGoalCost(node.tile) == 0)
+        {
+            finalNode = nodeIndex;
+            break;
+        }
+
+        int x = node.tile % width;
+        int y = node.tile / width;
+
+        // Waiting is a move too, so the loop covers the tile itself
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                if (x + dx < 0 || x + dx >= width || y + dy < 0 || y + dy >= height)
+                    continue;
+
+                int next = node.tile + dy * width + dx;
+                if (!canMove(node.tile, next, tick + node.time, agentIndex))
+                    continue;
+
+                int cost = node.cost + 1;
+                std::uint64_t key = reservationKey(next, node.time + 1);
+                auto best = bestNode.find(key);
+
+                if (best != bestNode.end() && nodes[best->second].cost <= cost)
+                    continue;
+
+                int nextIndex = static_cast<int>(nodes.size());
+                nodes.push_back({ next, node.time + 1, cost, nodeIndex });
+                bestNode[key] = nextIndex;
+                openNodes.push({ cost + getGoalCost(next), nextIndex });
+            }
+        }
+    }
+
+    agent.path.clear();
+    agent.planTick = tick;
+
+    for (int nodeIndex = finalNode; nodeIndex > 0; nodeIndex = nodes[nodeIndex].parent)
+    {
+        agent.path.push_back(nodes[nodeIndex].tile);
+    }
+    std::reverse(agent.path.begin(), agent.path.end());
+
+    reserve(agentIndex, agent.tile, tick);
+    for (size_t step = 0; step < agent.path.size(); step++)
+    {
+        reserve(agentIndex, agent.path[step], tick + static_cast<int>(step) + 1);
+    }
+
+    // Agents park on their last planned tile until the next plan. Nobody plans through a parked
+    // agent, which is what keeps the previous plan open when the agent replans.
+    int lastTile = agent.path.empty() ? agent.tile : agent.path.back();
+    if (getGoalCost(lastTile) != 0)
+    {
+        park(agentIndex, lastTile, tick + static_cast<int>(agent.path.size()));
+    }
+}
+
+void CooperativePlanner::reserve(int agentIndex, int tile, int atTick)
+{
+    std::uint64_t key = reservationKey(tile, atTick);
+    reservations[key] = agentIndex;
+    agents[agentIndex].reservations.push_back(key);
+}
+
+void CooperativePlanner::releaseReservations(int agentIndex)
+{
+    for (std::uint64_t key : agents[agentIndex].reservations)
+    {
+        auto reservation = reservations.find(key);
+        if (reservation != reservations.end() && reservation->second == agentIndex)
+        {
+            reservations.erase(reservation);
+        }
+    }
+    agents[agentIndex].reservations.clear();
+
+    int parkTile = agents[agentIndex].parkTile;
+    if (parkTile >= 0)
+    {
+        parked.erase(parkTile);
+        agents[agentIndex].parkTile = -1;
+    }
+}
+
+void CooperativePlanner::park(int agentIndex, int tile, int fromTick)
+{
+    parked[tile] = { agentIndex, fromTick };
+    agents[agentIndex].parkTile = tile;
+}
+
+bool CooperativePlanner::isFree(int agentIndex, int tile, int atTick) const
+{
+    auto reservation = reservations.find(reservationKey(tile, atTick));
+    if (reservation != reservations.end() && reservation->second != agentIndex)
+        return false;
+
+    auto parkedAgent = parked.find(tile);
+    return parkedAgent == parked.end() || parkedAgent->second.first == agentIndex || atTick < parkedAgent->second.second;
+}
+
+bool CooperativePlanner::canMove(int from, int to, int atTick, int agentIndex) const
+{
+    if (getGoalCost(to) < 0 || !isFree(agentIndex, to, atTick + 1))
+        return false;
+
+    if (from == to)
+        return true;
+
+    // Same movement rules as the flowfield: no diagonals on four connected grids, no cutting corners
+    int dx = to % width - from % width;
+    int dy = to / width - from / width;
+
+    if (dx != 0 && dy != 0)
+    {
+        if (flowField.getConnectivity() == FlowField::Connectivity::FOUR)
+            return false;
+
+        int fromX = from % width;
+        int fromY = from / width;
+        if (flowField.getTile(fromX + dx, fromY).terrainCost == 255 || flowField.getTile(fromX, fromY + dy).terrainCost == 255)
+            return false;
+    }
+
+    // No swapping places with an agent coming the other way
+    auto occupant = reservations.find(reservationKey(to, atTick));
+    if (occupant != reservations.end() && occupant->second != agentIndex)
+    {
+        auto swapped = reservations.find(reservationKey(from, atTick + 1));
+        if (swapped != reservations.end() && swapped->second == occupant->second)
+            return false;
+    }
+
+    return true;
+}
+
+int CooperativePlanner::getGoalCost(int tile) const
+{
+    return flowField.getTile(tile % width, tile / width).cost;
+}
+
+std::uint64_t CooperativePlanner::reservationKey(int tile, int atTick)
+{
+    return (static_cast<std::uint64_t>(atTick) << 32) | static_cast<std::uint32_t>(tile);
+}
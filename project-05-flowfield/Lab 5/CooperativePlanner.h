@@ -0,0 +1,95 @@
+#ifndef COOPERATIVEPLANNER_HPP
+#define COOPERATIVEPLANNER_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+class FlowField;
+
+// Windowed cooperative A* (WHCA*) for squads heading to the flowfield's goal. Each agent plans a
+// few ticks ahead through space and time around the moves other agents have already reserved,
+// so agents queue through chokepoints instead of walking into each other. The flowfield's cost
+// field is the exact distance to the goal ignoring other agents, which makes it the heuristic.
+// An agent keeps its last planned tile until it plans again, so a replan can always fall back on
+// the rest of the old plan and agents never collide.
+//
+// Agents replan every half window, staggered by id so each tick only replans a share of them,
+// and the planning order rotates every tick so no agent always yields. Agents that reach the goal
+// leave the grid and stop reserving tiles.
+class CooperativePlanner
+{
+public:
+    struct Stats
+    {
+        int replans = 0;
+        long long nodesExpanded = 0;
+        int waits = 0;                  // Agent ticks spent standing still before arriving
+        int arrived = 0;
+    };
+
+    explicit CooperativePlanner(const FlowField& flowField, int window = 8);
+
+    // Agents must start on distinct tiles that can reach the goal, returns -1 otherwise
+    int addAgent(sf::Vector2i tile);
+    void clearAgents();
+
+    // Plans where needed and moves every agent one tile (or keeps it waiting)
+    void update();
+
+    int getAgentCount() const;
+    sf::Vector2i getAgentTile(int agent) const;
+    bool hasArrived(int agent) const;
+    int getTick() const;
+    const Stats& getStats() const;
+
+private:
+    struct Agent
+    {
+        int tile;                               // Index into the flowfield's row by row grid
+        bool arrived = false;
+        std::vector<int> path;                  // Planned tiles for ticks planTick + 1 onwards
+        int planTick = 0;
+        std::vector<std::uint64_t> reservations;
+        int parkTile = -1;                      // Held from the end of the plan until the next one
+    };
+
+    struct SearchNode
+    {
+        int tile;
+        int time;                               // Ticks after the planning tick
+        int cost;                               // Ticks taken, waits included
+        int parent;
+    };
+
+    using OpenEntry = std::pair<int, int>;      // (cost + heuristic, node index)
+
+    const FlowField& flowField;
+    int window;
+    int width;
+    int height;
+    int tick = 0;
+    std::vector<Agent> agents;
+    std::unordered_map<std::uint64_t, int> reservations;   // (tick, tile) -> agent
+    std::unordered_map<int, std::pair<int, int>> parked;    // tile -> (agent, from tick)
+
+    // Search scratch space, kept between searches to avoid reallocating
+    std::vector<SearchNode> nodes;
+    std::unordered_map<std::uint64_t, int> bestNode;
+    std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> openNodes;
+
+    Stats stats;
+
+    void plan(int agentIndex);
+    void reserve(int agentIndex, int tile, int atTick);
+    void releaseReservations(int agentIndex);
+    void park(int agentIndex, int tile, int fromTick);
+    bool isFree(int agentIndex, int tile, int atTick) const;
+    bool canMove(int from, int to, int atTick, int agentIndex) const;
+    int getGoalCost(int tile) const;
+    static std::uint64_t reservationKey(int tile, int atTick);
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "CrowdSeparation.h"
+#include "Flowfield.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+CrowdSeparation::CrowdSeparation(float agentRadius, float strength)
+    : agentRadius(agentRadius), cellSize(2.0f * agentRadius), strength(strength)
+{
+}
+
+void CrowdSeparation::build(const std::vector<sf::Vector2f>& positions)
+{
+    int agentCount = static_cast<int>(positions.size());
+
+    // About two cells per agent keeps hash collisions between nearby cells rare
+    std::uint32_t tableSize = 64;
+    while (tableSize < 2u * static_cast<std::uint32_t>(agentCount))
+    {
+        tableSize *= 2;
+    }
+    cellMask = tableSize - 1;
+
+    // Counting sort: count agents per cell, turn the counts into start offsets, then scatter
+    agentCells.resize(agentCount);
+    cellStart.assign(tableSize + 1, 0);
+
+    for (int i = 0; i < agentCount; i++)
+    {
+        sf::Vector2i cell = getCell(positions[i]);
+        agentCells[i] = hashCell(cell.x, cell.y);
+        cellStart[agentCells[i] + 1]++;
+    }
+
+    stats.occupiedCells = 0;
+    for (std::uint32_t c = 0; c < tableSize; c++)
+    {
+        stats.occupiedCells += cellStart[c + 1] > 0;
+        cellStart[c + 1] += cellStart[c];
+    }
+
+    // Scatter in agent order, so agents within a cell keep their relative order. Positions are
+    // copied along with the indices, so neighbour loops read memory in order.
+    std::vector<int> next(cellStart.begin(), cellStart.end() - 1);
+    sortedAgents.resize(agentCount);
+    sortedPositions.resize(agentCount);
+
+    for (int i = 0; i < agentCount; i++)
+    {
+        int slot = next[agentCells[i]]++;
+        sortedAgents[slot] = i;
+        sortedPositions[slot] = positions[i];
+    }
+
+    stats.agents = agentCount;
+}
+
+void CrowdSeparation::findNeighbours(const std::vector<sf::Vector2f>& positions, sf::Vector2f position, float radius,
+                                     std::vector<int>& neighbours) const
+{
+    neighbours.clear();
+    if (sortedAgents.empty())
+        return;
+
+    // Cells within the radius, deduplicated by bucket so collisions never report an agent twice
+    sf::Vector2i low = getCell(position - sf::Vector2f(radius, radius));
+    sf::Vector2i high = getCell(position + sf::Vector2f(radius, radius));
+    std::vector<std::uint32_t> buckets;
+
+    for (int cellY = low.y; cellY <= high.y; cellY++)
+    {
+        for (int cellX = low.x; cellX <= high.x; cellX++)
+        {
+            std::uint32_t bucket = hashCell(cellX, cellY);
+            if (std::find(buckets.begin(), buckets.end(), bucket) == buckets.end())
+            {
+                buckets.push_back(bucket);
+            }
+        }
+    }
+
+    for (std::uint32_t bucket : buckets)
+    {
+        for (int s = cellStart[bucket]; s < cellStart[bucket + 1]; s++)
+        {
+            sf::Vector2f offset = positions[sortedAgents[s]] - position;
+            if (offset.x * offset.x + offset.y * offset.y <= radius * radius)
+            {
+                neighbours.push_back(sortedAgents[s]);
+            }
+        }
+    }
+}
+
+void CrowdSeparation::resolve(std::vector<sf::Vector2f>& positions, const FlowField& flowField, int passes, int maxThreads)
+{
+    int agentCount = static_cast<int>(positions.size());
+    stats.neighbourChecks = 0;
+    stats.overlaps = 0;
+
+    int workerCount = 1;
+    if (agentCount >= PARALLEL_AGENT_THRESHOLD)
+    {
+        int threadLimit = maxThreads > 0 ? maxThreads : static_cast<int>(std::thread::hardware_concurrency());
+        workerCount = std::max(1, std::min(threadLimit, agentCount / PARALLEL_AGENT_THRESHOLD + 1));
+    }
+
+    for (int pass = 0; pass < passes; pass++)
+    {
+        build(positions);
+        corrections.assign(agentCount, sf::Vector2f());
+
+        // Cells are handed out so each worker gets about the same number of agents. Every worker
+        // only writes the corrections of agents in its own cells.
+        int cellCount = static_cast<int>(cellMask) + 1;
+        std::vector<int> firstCells(workerCount + 1, cellCount);
+        firstCells[0] = 0;
+
+        for (int w = 1; w < workerCount; w++)
+        {
+            int firstAgent = static_cast<int>(static_cast<long long>(agentCount) * w / workerCount);
+            firstCells[w] = static_cast<int>(std::upper_bound(cellStart.begin(), cellStart.end(), firstAgent) - cellStart.begin()) - 1;
+            firstCells[w] = std::max(firstCells[w], firstCells[w - 1]);
+        }
+
+        std::vector<long long> neighbourChecks(workerCount, 0);
+        std::vector<int> overlaps(workerCount, 0);
+        std::vector<std::thread> workers;
+
+        for (int w = 1; w < workerCount; w++)
+        {
+            workers.emplace_back(&CrowdSeparation::separateRange, this, firstCells[w], firstCells[w + 1],
+                                 std::ref(neighbourChecks[w]), std::ref(overlaps[w]));
+        }
+
+        separateRange(firstCells[0], firstCells[1], neighbourChecks[0], overlaps[0]);
+
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+
+        stats.overlaps = 0;
+        for (int w = 0; w < workerCount; w++)
+        {
+            stats.neighbourChecks += neighbourChecks[w];
+            stats.overlaps += overlaps[w];
+        }
+
+        // Slide along walls: a push into an obstacle keeps whichever axis still lands on open ground
+        for (int i = 0; i < agentCount; i++)
+        {
+            sf::Vector2f position = positions[i];
+            sf::Vector2f correction = corrections[i];
+
+            if (correction.x == 0.0f && correction.y == 0.0f)
+                continue;
+
+            if (!isWalkable(flowField, position))
+            {
+                positions[i] = position + correction;
+            }
+            else if (isWalkable(flowField, position + correction))
+            {
+                positions[i] = position + correction;
+            }
+            else if (isWalkable(flowField, { position.x + correction.x, position.y }))
+            {
+                positions[i].x += correction.x;
+            }
+            else if (isWalkable(flowField, { position.x, position.y + correction.y }))
+            {
+                positions[i].y += correction.y;
+            }
+        }
+    }
+}
+
+float CrowdSeparation::getAgentRadius() const
+{
+    return agentRadius;
+}
+
+const CrowdSeparation::Stats& CrowdSeparation::getStats() const
+{
+    return stats;
+}
+
+sf::Vector2i CrowdSeparation::getCell(sf::Vector2f position) const
+{
+    return sf::Vector2i(static_cast<int>(std::floor(position.x / cellSize)),
+                        static_cast<int>(std::floor(position.y / cellSize)));
+}
+
+std::uint32_t CrowdSeparation::hashCell(int cellX, int cellY) const
+{
+    // Rows are scattered over the table, cells along a row stay next to each other, so the three
+    // cells of a row in a neighbourhood are three buckets in a row
+    std::uint32_t rowHash = static_cast<std::uint32_t>(cellY) * 2654435761u;
+    return (rowHash + static_cast<std::uint32_t>(cellX)) & cellMask;
+}
+
+int CrowdSeparation::getCellBuckets(sf::Vector2i cell, std::uint32_t (&buckets)[9]) const
+{
+    int count = 0;
+    std::uint32_t rowStarts[3];
+
+    for (int row = 0; row < 3; row++)
+    {
+        rowStarts[row] = hashCell(cell.x - 1, cell.y + row - 1);
+
+        for (std::uint32_t step = 0; step < 3; step++)
+        {
+            std::uint32_t bucket = (rowStarts[row] + step) & cellMask;
+
+            // Another row can only land on the same buckets when their runs of three overlap
+            bool seen = false;
+            for (int earlier = 0; earlier < row; earlier++)
+            {
+                seen = seen || ((bucket - rowStarts[earlier]) & cellMask) < 3;
+            }
+
+            if (!seen)
+            {
+                buckets[count++] = bucket;
+            }
+        }
+    }
+
+    return count;
+}
+
+void CrowdSeparation::separateRange(int firstCell, int lastCell, long long& neighbourChecks, int& overlaps)
+{
+    const float diameter = 2.0f * agentRadius;
+    std::uint32_t buckets[9];
+    int bucketCount = 0;
+    sf::Vector2i bucketsCell;
+
+    for (int cell = firstCell; cell < lastCell; cell++)
+    {
+        if (cellStart[cell] == cellStart[cell + 1])
+            continue;
+
+        // Agents in one bucket can come from different cells, so neighbours are found per agent,
+        // reusing the last agent's buckets when it was in the same cell. Cells are one diameter
+        // across, so the three by three block around an agent covers every agent it can touch.
+        for (int s = cellStart[cell]; s < cellStart[cell + 1]; s++)
+        {
+            int agent = sortedAgents[s];
+            sf::Vector2f position = sortedPositions[s];
+            sf::Vector2f push;
+
+            sf::Vector2i agentCell = getCell(position);
+            if (bucketCount == 0 || agentCell != bucketsCell)
+            {
+                bucketCount = getCellBuckets(agentCell, buckets);
+                bucketsCell = agentCell;
+            }
+
+            for (int b = 0; b < bucketCount; b++)
+            {
+                for (int t = cellStart[buckets[b]]; t < cellStart[buckets[b] + 1]; t++)
+                {
+                    int other = sortedAgents[t];
+                    if (other == agent)
+                        continue;
+
+                    neighbourChecks++;
+                    sf::Vector2f away = position - sortedPositions[t];
+                    float distanceSquared = away.x * away.x + away.y * away.y;
+
+                    if (distanceSquared >= diameter * diameter)
+                        continue;
+
+                    float distance = std::sqrt(distanceSquared);
+                    float overlap = diameter - distance;
+                    overlaps += agent < other;
+
+                    // Agents on the same spot are split along a fixed direction, opposite for each
+                    if (distance < MIN_SEPARATION)
+                    {
+                        away = sf::Vector2f(agent < other ? -1.0f : 1.0f, 0.0f);
+                        distance = 1.0f;
+                    }
+
+                    // Each agent takes half the push, the other half goes to its neighbour
+                    push += away * (0.5f * strength * overlap / distance);
+                }
+            }
+
+            // Capped at one radius, so no push can carry an agent through a wall tile
+            float pushLength = std::sqrt(push.x * push.x + push.y * push.y);
+            if (pushLength > agentRadius)
+            {
+                push *= agentRadius / pushLength;
+            }
+
+            corrections[agent] = push;
+        }
+    }
+}
+
+bool CrowdSeparation::isWalkable(const FlowField& flowField, sf::Vector2f position)
+{
+    sf::Vector2i tile = flowField.worldToGrid(position);
+
+    return tile.x >= 0 && tile.x < flowField.getGridWidth() && tile.y >= 0 && tile.y < flowField.getGridHeight() &&
+           flowField.getTile(tile.x, tile.y).terrainCost != 255;
+}
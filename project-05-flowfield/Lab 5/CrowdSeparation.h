@@ -0,0 +1,72 @@
+#ifndef CROWDSEPARATION_HPP
+#define CROWDSEPARATION_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+class FlowField;
+
+// Local separation for crowds following a flowfield. Agents that follow the same field all head
+// for the same tile centres and pile up, so after each tick's flow sampling and movement, every
+// pair of agents closer than two radii is pushed apart. An agent moves at most one radius per
+// pass, and never into an obstacle, it slides along it instead. Radii should stay under half a
+// tile so agents still fit through one tile gaps.
+//
+// Neighbours come from a uniform spatial hash with cells one agent diameter across. The hash is
+// rebuilt with a counting sort every pass, so agents end up sorted by cell and each cell's agents
+// sit next to each other in memory. Each pass works out every agent's push from the positions at
+// the start of the pass, so cells are split across threads with nothing shared between them.
+class CrowdSeparation
+{
+public:
+    struct Stats
+    {
+        int agents = 0;
+        int occupiedCells = 0;
+        long long neighbourChecks = 0;      // Pairs looked at by the last resolve, over all passes
+        int overlaps = 0;                   // Overlapping pairs found by the last pass
+    };
+
+    // Radius in world units, strength is the share of each overlap removed per pass
+    explicit CrowdSeparation(float agentRadius, float strength = 0.5f);
+
+    // Rebuilds the hash for these positions
+    void build(const std::vector<sf::Vector2f>& positions);
+
+    // Agents within 'radius' of the position, in no particular order. positions must be the ones
+    // the hash was last built from.
+    void findNeighbours(const std::vector<sf::Vector2f>& positions, sf::Vector2f position, float radius,
+                        std::vector<int>& neighbours) const;
+
+    // Rebuilds the hash and pushes overlapping agents apart, 'passes' times. Batches above
+    // PARALLEL_AGENT_THRESHOLD are split over up to maxThreads threads, 0 means one per hardware thread.
+    void resolve(std::vector<sf::Vector2f>& positions, const FlowField& flowField, int passes = 2, int maxThreads = 0);
+
+    float getAgentRadius() const;
+    const Stats& getStats() const;
+
+private:
+    static constexpr int PARALLEL_AGENT_THRESHOLD = 4096;   // Agents per thread before a pass is split
+    static constexpr float MIN_SEPARATION = 1e-4f;          // Closer than this, agents are split apart by index
+
+    float agentRadius;
+    float cellSize;
+    float strength;
+    std::uint32_t cellMask = 0;             // Table size - 1, the table is a power of two
+
+    std::vector<std::uint32_t> agentCells;  // Hashed cell of each agent
+    std::vector<int> cellStart;             // Sorted agents of cell c are cellStart[c] to cellStart[c + 1]
+    std::vector<int> sortedAgents;
+    std::vector<sf::Vector2f> sortedPositions;     // Agent positions in sorted order
+    std::vector<sf::Vector2f> corrections;
+    Stats stats;
+
+    sf::Vector2i getCell(sf::Vector2f position) const;
+    std::uint32_t hashCell(int cellX, int cellY) const;
+    int getCellBuckets(sf::Vector2i cell, std::uint32_t (&buckets)[9]) const;
+    void separateRange(int firstCell, int lastCell, long long& neighbourChecks, int& overlaps);
+    static bool isWalkable(const FlowField& flowField, sf::Vector2f position);
+};
+
+#endif
@@ -0,0 +1,331 @@
+#include "FieldCache.h"
+#include "Flowfield.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = static_cast<const std::uint8_t*>(view);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        ::close(file);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+    if (view == MAP_FAILED)
+    {
+        ::close(file);
+        return false;
+    }
+
+    fileDescriptor = file;
+    data = static_cast<const std::uint8_t*>(view);
+    size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle(mappingHandle);
+    CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    munmap(const_cast<std::uint8_t*>(data), size);
+    ::close(fileDescriptor);
+    fileDescriptor = -1;
+#endif
+
+    data = nullptr;
+    size = 0;
+}
+
+const std::uint8_t* MappedFile::getData() const
+{
+    return data;
+}
+
+size_t MappedFile::getSize() const
+{
+    return size;
+}
+
+FieldCache::FieldCache(const std::string& directory)
+    : directory(directory)
+{
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    if (error)
+    {
+        std::cout << "Error creating field cache directory " << directory << ": " << error.message() << std::endl;
+    }
+}
+
+FieldCache::~FieldCache()
+{
+    waitForWrites();
+}
+
+bool FieldCache::load(FlowField& flowField, sf::Vector2i goal)
+{
+    // Congestion and soft costs change all the time, only static fields are worth caching
+    if (flowField.isDynamicCostEnabled() || flowField.hasSoftCost())
+        return false;
+
+    std::uint64_t key = getKey(flowField, goal);
+    auto mapped = mappedFiles.find(key);
+
+    if (mapped == mappedFiles.end())
+    {
+        auto file = std::make_unique<MappedFile>();
+        if (!file->open(getPath(key)))
+            return false;
+
+        mapped = mappedFiles.emplace(key, std::move(file)).first;
+    }
+
+    const MappedFile& file = *mapped->second;
+    size_t tileCount = static_cast<size_t>(flowField.getGridWidth()) * flowField.getGridHeight();
+    size_t expectedSize = sizeof(FileHeader) + tileCount * (2 * sizeof(std::int32_t) + sizeof(std::int8_t));
+
+    FileHeader header{};
+    bool valid = file.getSize() == expectedSize;
+    if (valid)
+    {
+        std::memcpy(&header, file.getData(), sizeof(header));
+    }
+
+    // The key already covers all of this, the header just guards against hash collisions and stale files
+    valid = valid && std::memcmp(header.magic, "FFLD", 4) == 0 && header.version == FORMAT_VERSION && header.key == key &&
+            header.width == flowField.getGridWidth() && header.height == flowField.getGridHeight() &&
+            header.goalX == goal.x && header.goalY == goal.y && header.unitSize == flowField.getUnitSize() &&
+            header.connectivity == static_cast<std::int32_t>(flowField.getConnectivity());
+
+    // A bad file is unmapped again, so store can replace it
+    if (!valid)
+    {
+        mappedFiles.erase(mapped);
+        return false;
+    }
+
+    // Arrays follow the header back to back, the header size keeps them 4 byte aligned
+    const std::uint8_t* payload = file.getData() + sizeof(FileHeader);
+    const std::int32_t* costs = reinterpret_cast<const std::int32_t*>(payload);
+    const std::int32_t* integrationCosts = reinterpret_cast<const std::int32_t*>(payload + tileCount * sizeof(std::int32_t));
+    const std::int8_t* directions = reinterpret_cast<const std::int8_t*>(
+        payload + tileCount * 2 * sizeof(std::int32_t));
+
+    return flowField.importField(goal, costs, integrationCosts, directions);
+}
+
+void FieldCache::store(const FlowField& flowField)
+{
+    sf::Vector2i goal = flowField.getGoalTile();
+
+    if (flowField.isDynamicCostEnabled() || flowField.hasSoftCost() || flowField.isCostFieldBounded() || goal.x < 0)
+        return;
+
+    std::uint64_t key = getKey(flowField, goal);
+    if (mappedFiles.count(key) > 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+    removeFinishedWrites();
+
+    // Two writes of one key would share a temporary file, so a goal already being written is skipped
+    if (pendingWrites.count(key) > 0)
+        return;
+
+    FileHeader header{};
+    std::memcpy(header.magic, "FFLD", 4);
+    header.version = FORMAT_VERSION;
+    header.key = key;
+    header.width = flowField.getGridWidth();
+    header.height = flowField.getGridHeight();
+    header.goalX = goal.x;
+    header.goalY = goal.y;
+    header.unitSize = flowField.getUnitSize();
+    header.connectivity = static_cast<std::int32_t>(flowField.getConnectivity());
+
+    std::vector<std::int32_t> costs;
+    std::vector<std::int32_t> integrationCosts;
+    std::vector<std::int8_t> directions;
+    flowField.exportField(costs, integrationCosts, directions);
+
+    // The snapshot is owned by the task, so the flowfield is free to change while it writes
+    std::string path = getPath(key);
+    pendingWrites.emplace(key, std::async(std::launch::async,
+        [path, header, costs = std::move(costs), integrationCosts = std::move(integrationCosts),
+         directions = std::move(directions)]()
+        {
+            return writeFile(path, header, costs, integrationCosts, directions);
+        }));
+}
+
+bool FieldCache::setGoal(FlowField& flowField, sf::Vector2i goal)
+{
+    if (load(flowField, goal))
+        return true;
+
+    if (flowField.setGoalTile(goal))
+    {
+        store(flowField);
+    }
+    return false;
+}
+
+void FieldCache::waitForWrites()
+{
+    std::lock_guard<std::mutex> lock(writeMutex);
+
+    for (auto& [key, write] : pendingWrites)
+    {
+        if (!write.get())
+        {
+            std::cout << "Error writing field cache file." << std::endl;
+        }
+    }
+    pendingWrites.clear();
+}
+
+void FieldCache::removeFinishedWrites()
+{
+    // Called with writeMutex held, so a long session does not keep a future for every goal it cached
+    for (auto write = pendingWrites.begin(); write != pendingWrites.end();)
+    {
+        if (write->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            ++write;
+            continue;
+        }
+
+        if (!write->second.get())
+        {
+            std::cout << "Error writing field cache file." << std::endl;
+        }
+        write = pendingWrites.erase(write);
+    }
+}
+
+std::uint64_t FieldCache::getKey(const FlowField& flowField, sf::Vector2i goal) const
+{
+    const std::uint64_t FNV_PRIME = 1099511628211ull;
+
+    // Continue the terrain's FNV-1a hash with everything else that shapes the field
+    std::uint64_t hash = flowField.getTerrainHash();
+    const std::uint32_t values[] = { static_cast<std::uint32_t>(goal.x), static_cast<std::uint32_t>(goal.y),
+                                     static_cast<std::uint32_t>(flowField.getUnitSize()),
+                                     static_cast<std::uint32_t>(flowField.getIntegrationMode()),
+                                     static_cast<std::uint32_t>(flowField.getConnectivity()), FORMAT_VERSION };
+
+    for (std::uint32_t value : values)
+    {
+        for (int byte = 0; byte < 4; byte++)
+        {
+            hash ^= (value >> (byte * 8)) & 0xFF;
+            hash *= FNV_PRIME;
+        }
+    }
+
+    return hash;
+}
+
+std::string FieldCache::getPath(std::uint64_t key) const
+{
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".field";
+    return (std::filesystem::path(directory) / name.str()).string();
+}
+
+bool FieldCache::writeFile(const std::string& path, const FileHeader& header, const std::vector<std::int32_t>& costs,
+                           const std::vector<std::int32_t>& integrationCosts, const std::vector<std::int8_t>& directions)
+{
+    // Write next to the final name and rename, so a reader never maps a half written file
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(costs.data()), costs.size() * sizeof(std::int32_t));
+        file.write(reinterpret_cast<const char*>(integrationCosts.data()), integrationCosts.size() * sizeof(std::int32_t));
+        file.write(reinterpret_cast<const char*>(directions.data()), directions.size() * sizeof(std::int8_t));
+
+        if (!file)
+            return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    return !error;
+}
@@ -0,0 +1,92 @@
+#ifndef FIELDCACHE_HPP
+#define FIELDCACHE_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class FlowField;
+
+// Read only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    const std::uint8_t* getData() const;
+    size_t getSize() const;
+
+private:
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fileDescriptor = -1;
+#endif
+    const std::uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// Persistent cache of generated fields. Each field is stored in its own file named after a hash
+// of the terrain, goal, unit size, integration mode, connectivity and file format, so edited
+// terrain simply misses the cache. Files are written in the background and memory mapped when
+// read back.
+class FieldCache
+{
+public:
+    explicit FieldCache(const std::string& directory);
+    ~FieldCache();
+
+    // Restores the field for this goal on the flowfield's current terrain, false on a miss
+    bool load(FlowField& flowField, sf::Vector2i goal);
+
+    // Queues the flowfield's current field to be written, nothing is stored with congestion costs on
+    void store(const FlowField& flowField);
+
+    // Loads the goal from the cache, or generates it and stores it when missing. True on a cache hit.
+    bool setGoal(FlowField& flowField, sf::Vector2i goal);
+
+    void waitForWrites();
+    std::uint64_t getKey(const FlowField& flowField, sf::Vector2i goal) const;
+
+private:
+    static constexpr std::uint32_t FORMAT_VERSION = 3;
+
+    struct FileHeader
+    {
+        char magic[4];
+        std::uint32_t version;
+        std::uint64_t key;
+        std::int32_t width;
+        std::int32_t height;
+        std::int32_t goalX;
+        std::int32_t goalY;
+        std::int32_t unitSize;
+        std::int32_t connectivity;
+    };
+
+    std::string directory;
+
+    // Files stay mapped once opened, so reloading a goal costs no file system work
+    std::map<std::uint64_t, std::unique_ptr<MappedFile>> mappedFiles;
+
+    std::mutex writeMutex;
+    std::map<std::uint64_t, std::future<bool>> pendingWrites;     // Writes still in flight, by key
+
+    std::string getPath(std::uint64_t key) const;
+    void removeFinishedWrites();
+    static bool writeFile(const std::string& path, const FileHeader& header, const std::vector<std::int32_t>& costs,
+                          const std::vector<std::int32_t>& integrationCosts, const std::vector<std::int8_t>& directions);
+};
+
+#endif
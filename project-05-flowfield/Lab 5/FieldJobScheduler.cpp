@@ -0,0 +1,290 @@
+#include "FieldJobScheduler.h"
+#include "Flowfield.h"
+#include <algorithm>
+
+FieldJobScheduler::FieldJobScheduler(int width, int height, const std::vector<std::uint8_t>& terrain, int workerCount)
+    : terrain(terrain)
+{
+    // Generators are created up front on this thread, workers only ever touch their own one
+    workers.resize(std::max(1, workerCount));
+    for (Worker& worker : workers)
+    {
+        worker.generator = std::make_unique<FlowField>(width, height, 1.0f);
+        worker.generator->loadTerrain(terrain);
+    }
+
+    for (int i = 0; i < static_cast<int>(workers.size()); i++)
+    {
+        workers[i].thread = std::thread(&FieldJobScheduler::runWorker, this, i);
+    }
+}
+
+FieldJobScheduler::~FieldJobScheduler()
+{
+    std::vector<std::shared_ptr<Job>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+
+        for (const std::shared_ptr<Job>& job : runningJobs)
+        {
+            job->cancelled = true;
+        }
+        dropped.swap(pendingJobs);
+    }
+
+    jobAvailable.notify_all();
+    for (Worker& worker : workers)
+    {
+        worker.thread.join();
+    }
+
+    for (const std::shared_ptr<Job>& job : dropped)
+    {
+        complete(*job, makeResult(*job, FieldJobResult::Status::CANCELLED));
+    }
+}
+
+FieldJobTicket FieldJobScheduler::submit(sf::Vector2i goal, int unitSize, FieldJobPriority priority,
+                                         Clock::time_point deadline, int requester, Callback onComplete)
+{
+    auto job = std::make_shared<Job>();
+    job->requester = requester;
+    job->goal = goal;
+    job->unitSize = unitSize;
+    job->priority = priority;
+    job->deadline = deadline;
+    job->onComplete = std::move(onComplete);
+
+    FieldJobTicket ticket;
+    ticket.result = job->promise.get_future().share();
+
+    std::vector<std::shared_ptr<Job>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job->id = nextJobId++;
+        ticket.id = job->id;
+        stats.submitted++;
+
+        // A requester only ever wants its latest goal, anything older is wasted work
+        if (requester >= 0)
+        {
+            std::vector<std::shared_ptr<Job>> superseded;
+            for (const auto* jobs : { &pendingJobs, &runningJobs })
+            {
+                for (const std::shared_ptr<Job>& other : *jobs)
+                {
+                    if (other->requester == requester)
+                        superseded.push_back(other);
+                }
+            }
+
+            for (const std::shared_ptr<Job>& other : superseded)
+            {
+                cancelLocked(other, dropped);
+            }
+        }
+
+        pendingJobs.push_back(job);
+    }
+
+    // Every worker has to look, the reserved one may not be allowed to take this job
+    jobAvailable.notify_all();
+
+    for (const std::shared_ptr<Job>& other : dropped)
+    {
+        complete(*other, makeResult(*other, FieldJobResult::Status::CANCELLED));
+    }
+
+    return ticket;
+}
+
+void FieldJobScheduler::cancel(int jobId)
+{
+    std::vector<std::shared_ptr<Job>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (const auto* jobs : { &pendingJobs, &runningJobs })
+        {
+            auto job = std::find_if(jobs->begin(), jobs->end(),
+                                    [jobId](const std::shared_ptr<Job>& job) { return job->id == jobId; });
+            if (job != jobs->end())
+            {
+                // Copy first, cancelling erases the entry the iterator points at
+                std::shared_ptr<Job> found = *job;
+                cancelLocked(found, dropped);
+                break;
+            }
+        }
+    }
+
+    for (const std::shared_ptr<Job>& job : dropped)
+    {
+        complete(*job, makeResult(*job, FieldJobResult::Status::CANCELLED));
+    }
+}
+
+void FieldJobScheduler::setTerrain(const std::vector<std::uint8_t>& newTerrain)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    terrain = newTerrain;
+    terrainVersion++;
+}
+
+int FieldJobScheduler::getWorkerCount() const
+{
+    return static_cast<int>(workers.size());
+}
+
+FieldJobScheduler::Stats FieldJobScheduler::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void FieldJobScheduler::runWorker(int workerIndex)
+{
+    Worker& worker = workers[workerIndex];
+    bool playerOnly = workerIndex == 0 && workers.size() > 1;
+
+    while (true)
+    {
+        std::shared_ptr<Job> job;
+        std::vector<std::uint8_t> newTerrain;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobAvailable.wait(lock, [&]() { return stopping || findNextJob(playerOnly) >= 0; });
+
+            if (stopping)
+                return;
+
+            int next = findNextJob(playerOnly);
+            job = pendingJobs[next];
+            pendingJobs.erase(pendingJobs.begin() + next);
+            runningJobs.push_back(job);
+
+            if (worker.terrainVersion != terrainVersion)
+            {
+                newTerrain = terrain;
+                worker.terrainVersion = terrainVersion;
+            }
+        }
+
+        FlowField& generator = *worker.generator;
+        if (!newTerrain.empty())
+        {
+            generator.loadTerrain(newTerrain);
+        }
+
+        FieldJobResult result = makeResult(*job, FieldJobResult::Status::INVALID_GOAL);
+
+        if (Clock::now() > job->deadline)
+        {
+            result.status = FieldJobResult::Status::EXPIRED;
+        }
+        else
+        {
+            generator.setUnitSize(job->unitSize);
+
+            if (generator.setGoalTile(job->goal))
+            {
+                std::vector<std::int32_t> integrationCosts;
+                generator.exportField(result.costs, integrationCosts, result.directions);
+
+                // The goal itself has cost 0 unless it is too narrow for this unit size
+                if (result.costs[job->goal.y * generator.getGridWidth() + job->goal.x] == 0)
+                {
+                    result.status = FieldJobResult::Status::BUILT;
+                }
+            }
+        }
+
+        // Builds are not interrupted, a job cancelled while running just loses its result
+        if (job->cancelled)
+        {
+            result = makeResult(*job, FieldJobResult::Status::CANCELLED);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            runningJobs.erase(std::find(runningJobs.begin(), runningJobs.end(), job));
+        }
+
+        complete(*job, std::move(result));
+    }
+}
+
+int FieldJobScheduler::findNextJob(bool playerOnly) const
+{
+    int best = -1;
+
+    // Pending jobs are in submission order, so ties keep first come first served
+    for (int i = 0; i < static_cast<int>(pendingJobs.size()); i++)
+    {
+        const Job& job = *pendingJobs[i];
+
+        if (playerOnly && job.priority != FieldJobPriority::PLAYER)
+            continue;
+
+        if (best < 0 || job.priority < pendingJobs[best]->priority ||
+            (job.priority == pendingJobs[best]->priority && job.deadline < pendingJobs[best]->deadline))
+        {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+void FieldJobScheduler::cancelLocked(const std::shared_ptr<Job>& job, std::vector<std::shared_ptr<Job>>& dropped)
+{
+    job->cancelled = true;
+
+    // Pending jobs are completed by the caller once the lock is released, running ones by their worker
+    auto pending = std::find(pendingJobs.begin(), pendingJobs.end(), job);
+    if (pending != pendingJobs.end())
+    {
+        pendingJobs.erase(pending);
+        dropped.push_back(job);
+    }
+}
+
+FieldJobResult FieldJobScheduler::makeResult(const Job& job, FieldJobResult::Status status)
+{
+    FieldJobResult result;
+    result.status = status;
+    result.goal = job.goal;
+    result.unitSize = job.unitSize;
+    return result;
+}
+
+void FieldJobScheduler::complete(Job& job, FieldJobResult result)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        switch (result.status)
+        {
+        case FieldJobResult::Status::BUILT:
+            stats.built++;
+            if (Clock::now() > job.deadline)
+                stats.missedDeadlines++;
+            break;
+        case FieldJobResult::Status::CANCELLED:
+            stats.cancelled++;
+            break;
+        case FieldJobResult::Status::EXPIRED:
+            stats.expired++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (job.onComplete)
+    {
+        job.onComplete(result);
+    }
+    job.promise.set_value(std::move(result));
+}
@@ -0,0 +1,125 @@
+#ifndef FIELDJOBSCHEDULER_HPP
+#define FIELDJOBSCHEDULER_HPP
+
+#include <SFML/Graphics.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class FlowField;
+
+enum class FieldJobPriority
+{
+    PLAYER,         // Orders clicked by a player, never wait behind anything else
+    AI,             // Orders issued by computer players
+    BACKGROUND      // Pre-baking likely goals while the workers are idle
+};
+
+struct FieldJobResult
+{
+    enum class Status
+    {
+        BUILT,
+        INVALID_GOAL,       // Goal is blocked, off the grid or too narrow for the unit size
+        CANCELLED,          // Cancelled or superseded before the result was delivered
+        EXPIRED             // Deadline passed before a worker got to the job
+    };
+
+    Status status = Status::CANCELLED;
+    sf::Vector2i goal;
+    int unitSize = 1;
+    std::vector<std::int32_t> costs;        // Row by row, -1 = cannot reach the goal
+    std::vector<std::int8_t> directions;    // (dy + 1) * 3 + (dx + 1), so 4 means no direction
+};
+
+struct FieldJobTicket
+{
+    int id = -1;
+    std::shared_future<FieldJobResult> result;
+};
+
+// Builds fields on a fixed pool of worker threads, each with its own copy of the terrain.
+// Jobs run in priority order, earliest deadline first within a priority. With more than one
+// worker, the first worker only ever takes player jobs, so a burst of background work can never
+// hold up a click. Jobs can be cancelled, and a new job from the same requester supersedes the
+// requester's older ones.
+class FieldJobScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = std::function<void(const FieldJobResult&)>;
+
+    struct Stats
+    {
+        int submitted = 0;
+        int built = 0;
+        int cancelled = 0;
+        int expired = 0;
+        int missedDeadlines = 0;        // Built, but finished after the deadline
+    };
+
+    FieldJobScheduler(int width, int height, const std::vector<std::uint8_t>& terrain, int workerCount);
+    ~FieldJobScheduler();
+    FieldJobScheduler(const FieldJobScheduler&) = delete;
+    FieldJobScheduler& operator=(const FieldJobScheduler&) = delete;
+
+    // requester -1 never supersedes anything. The callback runs on the worker thread, or on the
+    // calling thread for jobs cancelled before they started.
+    FieldJobTicket submit(sf::Vector2i goal, int unitSize, FieldJobPriority priority,
+                          Clock::time_point deadline = Clock::time_point::max(), int requester = -1,
+                          Callback onComplete = nullptr);
+    void cancel(int jobId);
+
+    // Jobs submitted after this see the new terrain, jobs already running finish on the old one
+    void setTerrain(const std::vector<std::uint8_t>& terrain);
+
+    int getWorkerCount() const;
+    Stats getStats() const;
+
+private:
+    struct Job
+    {
+        int id;
+        int requester;
+        sf::Vector2i goal;
+        int unitSize;
+        FieldJobPriority priority;
+        Clock::time_point deadline;
+        Callback onComplete;
+        std::promise<FieldJobResult> promise;
+        std::atomic<bool> cancelled{ false };
+    };
+
+    struct Worker
+    {
+        std::unique_ptr<FlowField> generator;
+        int terrainVersion = 0;
+        std::thread thread;
+    };
+
+    mutable std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::vector<std::shared_ptr<Job>> pendingJobs;      // Kept in submission order
+    std::vector<std::shared_ptr<Job>> runningJobs;
+    std::vector<Worker> workers;
+    std::vector<std::uint8_t> terrain;
+    int terrainVersion = 0;
+    int nextJobId = 0;
+    bool stopping = false;
+    Stats stats;
+
+    void runWorker(int workerIndex);
+    int findNextJob(bool playerOnly) const;
+    void cancelLocked(const std::shared_ptr<Job>& job, std::vector<std::shared_ptr<Job>>& dropped);
+    static FieldJobResult makeResult(const Job& job, FieldJobResult::Status status);
+    void complete(Job& job, FieldJobResult result);
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "FlowFieldBroker.h"
+#include "Flowfield.h"
+#include <algorithm>
+
+float FlowFieldBroker::Stats::getSharingRatio() const
+{
+    return fieldsBuilt > 0 ? static_cast<float>(requests) / fieldsBuilt : 0.0f;
+}
+
+FlowFieldBroker::FlowFieldBroker(FlowField& generator, int mergeRadius)
+    : generator(generator), mergeRadius(mergeRadius)
+{
+}
+
+int FlowFieldBroker::acquire(sf::Vector2i goal, int unitSize)
+{
+    bool exact = false;
+    int fieldId = findSharedField(goal, unitSize, exact);
+
+    if (fieldId < 0)
+    {
+        BrokeredField field;
+        field.goal = goal;
+        field.unitSize = unitSize;
+
+        if (!buildField(field))
+            return -1;
+
+        fieldId = nextFieldId++;
+        fields.emplace(fieldId, std::move(field));
+        stats.liveFields++;
+        stats.peakLiveFields = std::max(stats.peakLiveFields, stats.liveFields);
+    }
+    else if (exact)
+    {
+        stats.exactShares++;
+    }
+    else
+    {
+        stats.nearbyShares++;
+    }
+
+    fields[fieldId].refCount++;
+    stats.requests++;
+    return fieldId;
+}
+
+void FlowFieldBroker::release(int fieldId)
+{
+    auto field = fields.find(fieldId);
+    if (field == fields.end())
+        return;
+
+    if (--field->second.refCount > 0)
+        return;
+
+    fields.erase(field);
+    stats.liveFields--;
+    stats.fieldsReleased++;
+}
+
+void FlowFieldBroker::update()
+{
+    std::uint64_t terrainHash = generator.getTerrainHash();
+
+    for (auto& [fieldId, field] : fields)
+    {
+        if (field.terrainHash == terrainHash || buildField(field))
+            continue;
+
+        // A goal that got walled in keeps its id, agents holding it find no direction until they release it
+        std::fill(field.costs.begin(), field.costs.end(), -1);
+        std::fill(field.directions.begin(), field.directions.end(), 4);
+        field.terrainHash = terrainHash;
+    }
+}
+
+const BrokeredField* FlowFieldBroker::getField(int fieldId) const
+{
+    auto field = fields.find(fieldId);
+    return field != fields.end() ? &field->second : nullptr;
+}
+
+sf::Vector2i FlowFieldBroker::getFlowDirection(int fieldId, int x, int y) const
+{
+    const BrokeredField* field = getField(fieldId);
+    if (field == nullptr || x < 0 || x >= generator.getGridWidth() || y < 0 || y >= generator.getGridHeight())
+        return { 0, 0 };
+
+    int direction = field->directions[y * generator.getGridWidth() + x];
+    return sf::Vector2i(direction % 3 - 1, direction / 3 - 1);
+}
+
+int FlowFieldBroker::getCost(int fieldId, int x, int y) const
+{
+    const BrokeredField* field = getField(fieldId);
+    if (field == nullptr || x < 0 || x >= generator.getGridWidth() || y < 0 || y >= generator.getGridHeight())
+        return -1;
+
+    return field->costs[y * generator.getGridWidth() + x];
+}
+
+const FlowFieldBroker::Stats& FlowFieldBroker::getStats() const
+{
+    return stats;
+}
+
+int FlowFieldBroker::findSharedField(sf::Vector2i goal, int unitSize, bool& exact) const
+{
+    int width = generator.getGridWidth();
+    if (goal.x < 0 || goal.x >= width || goal.y < 0 || goal.y >= generator.getGridHeight())
+        return -1;
+
+    // Matches hold a few dozen live goals at most, so a linear scan beats keeping an index up to date.
+    // A nearby goal is measured along the field's own costs, so a goal on the far side of a wall
+    // never shares a field with one just across it.
+    int bestField = -1;
+    int bestCost = mergeRadius + 1;
+
+    for (const auto& [fieldId, field] : fields)
+    {
+        if (field.unitSize != unitSize)
+            continue;
+
+        int cost = field.costs[goal.y * width + goal.x];
+        if (cost >= 0 && cost < bestCost)
+        {
+            bestField = fieldId;
+            bestCost = cost;
+        }
+    }
+
+    exact = bestCost == 0;
+    return bestField;
+}
+
+bool FlowFieldBroker::buildField(BrokeredField& field)
+{
+    // The generator's start tile is UI state, a goal on it is still a valid field
+    generator.setUnitSize(field.unitSize);
+    if (!generator.buildGoalField(field.goal))
+        return false;
+
+    std::vector<std::int32_t> integrationCosts;
+    generator.exportField(field.costs, integrationCosts, field.directions);
+    field.terrainHash = generator.getTerrainHash();
+
+    // The goal itself has cost 0 unless it is too narrow for this unit size
+    if (field.costs[field.goal.y * generator.getGridWidth() + field.goal.x] != 0)
+        return false;
+
+    stats.fieldsBuilt++;
+    return true;
+}
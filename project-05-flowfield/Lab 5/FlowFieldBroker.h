@@ -0,0 +1,70 @@
+#ifndef FLOWFIELDBROKER_HPP
+#define FLOWFIELDBROKER_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+class FlowField;
+
+// One generated field shared by every agent heading for the same goal
+struct BrokeredField
+{
+    sf::Vector2i goal;
+    int unitSize = 1;
+    int refCount = 0;
+    std::uint64_t terrainHash = 0;          // Terrain the field was built on
+    std::vector<std::int32_t> costs;        // Row by row, -1 = cannot reach the goal
+    std::vector<std::int8_t> directions;    // (dy + 1) * 3 + (dx + 1), so 4 means no direction
+};
+
+// Hands out shared fields to agents. Agents acquire a field for a (goal, unit size) pair and
+// release it when they arrive or change orders. A request reuses a live field when its goal is
+// the same or within a few path steps of that field's goal, and a field is dropped once its last
+// agent releases it.
+//
+// Fields are generated on the flowfield given to the broker, so building one moves that
+// flowfield's goal and unit size. Use a flowfield dedicated to the broker when that matters.
+class FlowFieldBroker
+{
+public:
+    struct Stats
+    {
+        int requests = 0;           // acquire() calls that returned a field
+        int exactShares = 0;        // Requests served by a field for the very same goal
+        int nearbyShares = 0;       // Requests served by a field for a goal close by
+        int fieldsBuilt = 0;        // Including rebuilds after terrain changes
+        int fieldsReleased = 0;
+        int liveFields = 0;
+        int peakLiveFields = 0;
+
+        float getSharingRatio() const;      // Requests per field built
+    };
+
+    explicit FlowFieldBroker(FlowField& generator, int mergeRadius = 2);
+
+    // Field id for this goal and unit size, -1 when the goal cannot hold a unit of that size
+    int acquire(sf::Vector2i goal, int unitSize);
+    void release(int fieldId);
+
+    // Rebuilds every live field whose terrain has changed since it was generated
+    void update();
+
+    const BrokeredField* getField(int fieldId) const;
+    sf::Vector2i getFlowDirection(int fieldId, int x, int y) const;
+    int getCost(int fieldId, int x, int y) const;
+    const Stats& getStats() const;
+
+private:
+    FlowField& generator;
+    int mergeRadius;                        // Path steps from a field's goal that still share it
+    int nextFieldId = 0;
+    std::map<int, BrokeredField> fields;
+    Stats stats;
+
+    int findSharedField(sf::Vector2i goal, int unitSize, bool& exact) const;
+    bool buildField(BrokeredField& field);
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef FLOWFIELDPOLICIES_HPP
+#define FLOWFIELDPOLICIES_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Compile time variants for the hot loops of FlowField. Each kernel is instantiated once per
+// policy, so the neighbour count is a constant the compiler can unroll and grids without
+// diagonal moves never pay for the corner checks.
+
+// Neighbourhoods use the first COUNT entries of FlowField's DX/DY tables, which list the four
+// straight moves before the diagonals
+struct FourConnected
+{
+    static constexpr int COUNT = 4;
+    static constexpr bool HAS_DIAGONALS = false;
+};
+
+// Diagonal moves need both straight tiles next to them to be open, so units never cut corners.
+// Connected regions rely on this rule, see FlowField::createComponents().
+struct EightConnected
+{
+    static constexpr int COUNT = 8;
+    static constexpr bool HAS_DIAGONALS = true;
+};
+
+// Integration metrics turn a cost field value and the offset to the goal into an integration cost
+struct EuclideanMetric
+{
+    static int getIntegrationCost(int cost, int dx, int dy, float tileSize)
+    {
+        // Cost field is in steps, so scale by tileSize to match the Euclidean distance scale
+        float euclideanDist = std::sqrt(static_cast<float>(dx * dx + dy * dy));
+        return static_cast<int>(cost * tileSize) + static_cast<int>(euclideanDist * tileSize);
+    }
+};
+
+// Integer only, so every machine and compiler produces the same field bit for bit
+struct FixedOctileMetric
+{
+    static constexpr int STRAIGHT_COST = 70;    // 99 / 70 is within 0.01% of sqrt(2)
+    static constexpr int DIAGONAL_COST = 99;
+
+    static int getIntegrationCost(int cost, int dx, int dy, float)
+    {
+        int longSide = std::max(std::abs(dx), std::abs(dy));
+        int shortSide = std::min(std::abs(dx), std::abs(dy));
+        int octileDist = longSide * STRAIGHT_COST + shortSide * (DIAGONAL_COST - STRAIGHT_COST);
+        return cost * STRAIGHT_COST + octileDist;
+    }
+};
+
+#endif
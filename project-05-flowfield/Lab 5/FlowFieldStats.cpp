@@ -0,0 +1,152 @@
+#include "FlowFieldStats.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+RollingStat::RollingStat(size_t windowSize)
+    : samples(windowSize, 0.0)
+{
+}
+
+void RollingStat::addSample(double value)
+{
+    samples[nextSample] = value;
+    nextSample = (nextSample + 1) % samples.size();
+    count = std::min(count + 1, samples.size());
+    last = value;
+}
+
+void RollingStat::clear()
+{
+    nextSample = 0;
+    count = 0;
+    last = 0.0;
+}
+
+size_t RollingStat::getCount() const
+{
+    return count;
+}
+
+double RollingStat::getLast() const
+{
+    return last;
+}
+
+double RollingStat::getMin() const
+{
+    if (count == 0)
+        return 0.0;
+
+    return *std::min_element(samples.begin(), samples.begin() + count);
+}
+
+double RollingStat::getAverage() const
+{
+    if (count == 0)
+        return 0.0;
+
+    double total = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        total += samples[i];
+    }
+    return total / count;
+}
+
+double RollingStat::getPercentile(double percentile) const
+{
+    if (count == 0)
+        return 0.0;
+
+    // Only the window is sorted, and only when someone asks, so recording stays cheap
+    std::vector<double> sorted(samples.begin(), samples.begin() + count);
+    size_t rank = std::min(count - 1, static_cast<size_t>(percentile / 100.0 * count));
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+void FlowFieldStats::recordTime(Stage stage, double milliseconds)
+{
+    timings[static_cast<size_t>(stage)].addSample(milliseconds);
+}
+
+const RollingStat& FlowFieldStats::getTiming(Stage stage) const
+{
+    return timings[static_cast<size_t>(stage)];
+}
+
+const char* FlowFieldStats::getStageName(Stage stage)
+{
+    switch (stage)
+    {
+    case Stage::COST_FIELD:        return "cost";
+    case Stage::INTEGRATION_FIELD: return "integration";
+    case Stage::SHORTEST_PATH:     return "path";
+    case Stage::DYNAMIC_COST:      return "dynamic";
+    case Stage::RENDER:            return "render";
+    case Stage::SAMPLE_DIRECTIONS: return "sample";
+    case Stage::MULTI_GOAL:        return "multigoal";
+    default:                       return "unknown";
+    }
+}
+
+std::string FlowFieldStats::getSummary() const
+{
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(3);
+    summary << "Stage timings (ms)\nmin / avg / p99\n\n";
+
+    for (size_t i = 0; i < timings.size(); i++)
+    {
+        const RollingStat& timing = timings[i];
+        summary << getStageName(static_cast<Stage>(i)) << "\n  "
+                << timing.getMin() << " / " << timing.getAverage() << " / " << timing.getPercentile(99.0) << "\n";
+    }
+
+    summary << "\nTiles visited: " << counters.tilesVisited
+            << "\nQueue pushes: " << counters.queuePushes
+            << "\nPath length: " << counters.pathLength
+            << "\nDraw calls: " << counters.drawCalls << "\n";
+
+    return summary.str();
+}
+
+bool FlowFieldStats::dumpCsv(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file)
+        return false;
+
+    file << "stage,samples,last_ms,min_ms,avg_ms,p99_ms\n";
+    for (size_t i = 0; i < timings.size(); i++)
+    {
+        const RollingStat& timing = timings[i];
+        file << getStageName(static_cast<Stage>(i)) << ','
+             << timing.getCount() << ','
+             << timing.getLast() << ','
+             << timing.getMin() << ','
+             << timing.getAverage() << ','
+             << timing.getPercentile(99.0) << '\n';
+    }
+
+    file << "\ncounter,value\n"
+         << "tiles_visited," << counters.tilesVisited << '\n'
+         << "queue_pushes," << counters.queuePushes << '\n'
+         << "path_length," << counters.pathLength << '\n'
+         << "draw_calls," << counters.drawCalls << '\n';
+
+    return static_cast<bool>(file);
+}
+
+ScopedStageTimer::ScopedStageTimer(FlowFieldStats& stats, FlowFieldStats::Stage stage)
+    : stats(stats), stage(stage), startTime(std::chrono::steady_clock::now())
+{
+}
+
+ScopedStageTimer::~ScopedStageTimer()
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - startTime;
+    stats.recordTime(stage, elapsed.count());
+}
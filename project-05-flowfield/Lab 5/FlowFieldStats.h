@@ -0,0 +1,85 @@
+#ifndef FLOWFIELDSTATS_HPP
+#define FLOWFIELDSTATS_HPP
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Fixed size window of recent samples with min / average / 99th percentile
+class RollingStat
+{
+public:
+    explicit RollingStat(size_t windowSize = 240);
+
+    void addSample(double value);
+    void clear();
+
+    size_t getCount() const;
+    double getLast() const;
+    double getMin() const;
+    double getAverage() const;
+    double getPercentile(double percentile) const;
+
+private:
+    std::vector<double> samples;
+    size_t nextSample = 0;
+    size_t count = 0;
+    double last = 0.0;
+};
+
+class FlowFieldStats
+{
+public:
+    enum class Stage
+    {
+        COST_FIELD,
+        INTEGRATION_FIELD,
+        SHORTEST_PATH,
+        DYNAMIC_COST,
+        RENDER,
+        SAMPLE_DIRECTIONS,
+        MULTI_GOAL,
+        COUNT
+    };
+
+    // Work counters for the most recent run of each stage
+    struct Counters
+    {
+        int tilesVisited = 0;
+        int queuePushes = 0;
+        int pathLength = 0;
+        int drawCalls = 0;
+    };
+
+    void recordTime(Stage stage, double milliseconds);
+    const RollingStat& getTiming(Stage stage) const;
+    static const char* getStageName(Stage stage);
+
+    Counters counters;
+
+    // Text summary for the UI panel and a CSV dump for offline analysis
+    std::string getSummary() const;
+    bool dumpCsv(const std::string& path) const;
+
+private:
+    std::array<RollingStat, static_cast<size_t>(Stage::COUNT)> timings;
+};
+
+// Times its own lifetime and records it against a stage
+class ScopedStageTimer
+{
+public:
+    ScopedStageTimer(FlowFieldStats& stats, FlowFieldStats::Stage stage);
+    ~ScopedStageTimer();
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    FlowFieldStats& stats;
+    FlowFieldStats::Stage stage;
+    std::chrono::steady_clock::time_point startTime;
+};
+
+#endif
@@ -0,0 +1,1869 @@
+#include "FlowFieldValidator.h"
+#include "Flowfield.h"
+#include "FieldCache.h"
+#include "FlowFieldBroker.h"
+#include "FieldJobScheduler.h"
+#include "CooperativePlanner.h"
+#include "QuadtreeField.h"
+#include "InfluenceMap.h"
+#include "GridRaycaster.h"
+#include "FormationNavigator.h"
+#include "CrowdSeparation.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <sstream>
+
+FlowFieldValidator::FlowFieldValidator(unsigned int seed)
+    : rng(seed)
+{
+}
+
+bool FlowFieldValidator::runCorrectness(int mapCount)
+{
+    failures = 0;
+
+    // Size classes on a hand built map, before the random ones
+    checkUnitSizeGaps();
+
+    const int FAMILY_COUNT = static_cast<int>(MapGenerator::Family::COUNT);
+    const float densities[] = { 0.1f, 0.25f, 0.4f };
+
+    for (int i = 0; i < mapCount; i++)
+    {
+        MapGenerator::Family family = static_cast<MapGenerator::Family>(i % FAMILY_COUNT);
+        float density = densities[(i / FAMILY_COUNT) % 3];
+        int width = 16 + static_cast<int>(rng() % 49);
+        int height = 16 + static_cast<int>(rng() % 49);
+
+        // Cave fill below about 0.3 erodes to an empty map, so caves use the upper end of the range
+        if (family == MapGenerator::Family::CAVES)
+        {
+            density += 0.2f;
+        }
+
+        std::ostringstream name;
+        name << MapGenerator::getFamilyName(family) << " #" << i << " (" << width << "x" << height << ", p=" << density << ")";
+
+        FlowField flowField(width, height, 60.0f);
+        MapGenerator generator(rng());
+        std::vector<std::uint8_t> terrain = generator.generate(family, width, height, density);
+        flowField.loadTerrain(terrain);
+
+        sf::Vector2i goal = randomOpenTile(flowField);
+        if (goal.x < 0)
+            continue;
+
+        // Plain BFS field
+        flowField.setGoalTile(goal);
+        flowField.setStartTile(randomOpenTile(flowField));
+        checkField(flowField, name.str(), false);
+
+        // Paths for a crowd of starts extracted together
+        checkPathTree(flowField, name.str() + " path tree");
+
+        // Rays against the obstacle grid, single and batched, and the path smoothed with them
+        checkGridRaycaster(flowField, terrain, name.str() + " raycast");
+
+        // Block level field on a quadtree of the same terrain
+        checkQuadtreeField(flowField, terrain, name.str() + " quadtree");
+
+        // Same field with the integer octile distance term, single and batched
+        flowField.setIntegrationMode(FlowField::IntegrationMode::FIXED_OCTILE);
+        checkField(flowField, name.str() + " fixed", false);
+        checkMultiGoalFields(flowField, name.str() + " fixed multi-goal");
+        flowField.setIntegrationMode(FlowField::IntegrationMode::EUCLIDEAN);
+
+        // Four connected grids, straight moves only
+        flowField.setConnectivity(FlowField::Connectivity::FOUR);
+        checkField(flowField, name.str() + " 4-connected", false);
+        checkMultiGoalFields(flowField, name.str() + " 4-connected multi-goal");
+        flowField.setConnectivity(FlowField::Connectivity::EIGHT);
+
+        // Straight line directions for tiles in sight of the goal
+        checkLineOfSight(flowField, name.str() + " line of sight");
+
+        // Cached copy of the same field restored into a fresh flowfield
+        checkFieldCache(flowField, terrain, name.str() + " cached");
+
+        // Shared fields handed out to several agents
+        checkFieldBroker(flowField, terrain, name.str() + " broker");
+
+        // Fields built on worker threads, with superseded and cancelled jobs mixed in
+        checkJobScheduler(flowField, terrain, name.str() + " scheduled");
+
+        // A squad walking to the goal around each other's reservations
+        checkCooperativePlanner(flowField, name.str() + " squad");
+
+        // A crowd following the field, kept apart by the spatial hash
+        checkCrowdSeparation(flowField, name.str() + " crowd");
+
+        // Formations following the field, squeezing through gaps on the way
+        checkFormationNavigator(flowField, terrain, name.str() + " formation");
+
+        // Batched fields for several goals, the first one being the goal just checked
+        checkMultiGoalFields(flowField, name.str() + " multi-goal");
+
+        // Every unit size class against a footprint by footprint reference
+        checkUnitSizes(flowField, terrain, name.str() + " unit sizes");
+
+        // Bounded field around a few agents, then expanded lazily for more
+        checkBoundedField(flowField, name.str() + " bounded");
+
+        // Threat influence fed in as soft costs, then moved so the field is repaired in place
+        checkInfluenceMap(flowField, name.str() + " influence");
+
+        // Weighted field after a few incremental congestion repairs
+        flowField.setDynamicCostEnabled(true);
+        for (int tick = 0; tick < 3; tick++)
+        {
+            splatRandomAgents(flowField, width * height / 4);
+        }
+        checkField(flowField, name.str() + " congested", true);
+    }
+
+    std::error_code error;
+    std::filesystem::remove_all(getCacheDirectory(), error);
+
+    std::cout << "FlowField validation: " << mapCount << " maps, " << failures << " failures" << std::endl;
+    return failures == 0;
+}
+
+bool FlowFieldValidator::runBenchmark(const std::string& baselinePath, float threshold)
+{
+    // Benchmark maps always come from the same seed so runs stay comparable
+    rng.seed(12345);
+
+    const int MAP_SIZE = 256;
+    const int QUERIES_PER_MAP = 20;
+    const int AGENT_COUNT = 20000;
+    const int MULTI_GOAL_COUNT = 16;
+    const FlowFieldStats::Stage stages[] = { FlowFieldStats::Stage::COST_FIELD,
+                                             FlowFieldStats::Stage::INTEGRATION_FIELD,
+                                             FlowFieldStats::Stage::SHORTEST_PATH,
+                                             FlowFieldStats::Stage::SAMPLE_DIRECTIONS,
+                                             FlowFieldStats::Stage::MULTI_GOAL };
+
+    std::map<std::string, double> results;
+
+    for (int familyIndex = 0; familyIndex < static_cast<int>(MapGenerator::Family::COUNT); familyIndex++)
+    {
+        MapGenerator::Family family = static_cast<MapGenerator::Family>(familyIndex);
+        MapGenerator generator(rng());
+
+        FlowField flowField(MAP_SIZE, MAP_SIZE, 60.0f);
+        flowField.loadTerrain(generator.generate(family, MAP_SIZE, MAP_SIZE, getBenchmarkDensity(family)));
+
+        // Agents scattered over the whole map, sampled once per query like an AI tick would
+        std::uniform_real_distribution<float> coordinate(0.0f, MAP_SIZE * 60.0f);
+        std::vector<sf::Vector2f> agents(AGENT_COUNT);
+        for (sf::Vector2f& agent : agents)
+        {
+            agent = flowField.gridToWorld(0, 0) + sf::Vector2f(coordinate(rng), coordinate(rng));
+        }
+        std::vector<sf::Vector2f> directions;
+
+        for (int i = 0; i < QUERIES_PER_MAP; i++)
+        {
+            flowField.setGoalTile(randomOpenTile(flowField));
+            flowField.setStartTile(randomOpenTile(flowField));
+            flowField.sampleDirections(agents, directions,
+                i % 2 == 0 ? FlowField::SampleMode::NEAREST : FlowField::SampleMode::BILINEAR);
+        }
+
+        // One batch per squad count a busy tick might see
+        for (int i = 0; i < QUERIES_PER_MAP / 4; i++)
+        {
+            std::vector<sf::Vector2i> goals(MULTI_GOAL_COUNT);
+            for (sf::Vector2i& goal : goals)
+            {
+                goal = randomOpenTile(flowField);
+            }
+            flowField.createMultiGoalFields(goals);
+        }
+
+        for (FlowFieldStats::Stage stage : stages)
+        {
+            std::string key = std::string(MapGenerator::getFamilyName(family)) + "_" + FlowFieldStats::getStageName(stage);
+            results[key] = flowField.getStats().getTiming(stage).getAverage();
+        }
+    }
+
+    std::map<std::string, double> baselines;
+    std::ifstream baselineFile(baselinePath);
+    std::string line;
+
+    while (std::getline(baselineFile, line))
+    {
+        size_t comma = line.find(',');
+        if (comma == std::string::npos || line.compare(0, comma, "stage") == 0)
+            continue;
+
+        baselines[line.substr(0, comma)] = std::stod(line.substr(comma + 1));
+    }
+
+    bool passed = true;
+    for (const auto& [key, milliseconds] : results)
+    {
+        auto baseline = baselines.find(key);
+        std::cout << key << ": " << milliseconds << " ms";
+
+        if (baseline != baselines.end())
+        {
+            std::cout << " (baseline " << baseline->second << " ms)";
+
+            if (milliseconds > baseline->second * (1.0 + threshold))
+            {
+                std::cout << " REGRESSION";
+                passed = false;
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    // First run on a machine records the baselines to compare against
+    if (baselines.empty())
+    {
+        std::ofstream output(baselinePath);
+        output << "stage,avg_ms\n";
+
+        for (const auto& [key, milliseconds] : results)
+        {
+            output << key << ',' << milliseconds << '\n';
+        }
+        std::cout << "Wrote benchmark baselines to " << baselinePath << std::endl;
+    }
+
+    return passed;
+}
+
+bool FlowFieldValidator::checkField(const FlowField& flowField, const std::string& mapName, bool weighted)
+{
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    sf::Vector2i goal = flowField.getGoalTile();
+    std::vector<int> expected = referenceCosts(flowField, goal, weighted);
+
+    int failuresBefore = failures;
+    float worstStretch = 1.0f;
+
+    auto isOpen = [&](int x, int y)
+    {
+        return x >= 0 && x < width && y >= 0 && y < height && flowField.getTile(x, y).terrainCost != OBSTACLE;
+    };
+
+    // Every tile must carry the optimal cost, and -1 exactly when it cannot reach the goal
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int cost = flowField.getTile(x, y).cost;
+
+            if (cost != expected[y * width + x])
+            {
+                std::ostringstream message;
+                message << "cost at (" << x << ", " << y << ") is " << cost << ", expected " << expected[y * width + x];
+                reportFailure(mapName, message.str());
+                return false;
+            }
+        }
+    }
+
+    // Batch sampling at tile centres has to agree with the stored directions in both modes
+    std::vector<sf::Vector2f> centres;
+    centres.reserve(width * height);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            centres.push_back(flowField.getTileCenter(x, y));
+        }
+    }
+
+    std::vector<sf::Vector2f> nearest;
+    std::vector<sf::Vector2f> bilinear;
+    flowField.sampleDirections(centres, nearest, FlowField::SampleMode::NEAREST);
+    flowField.sampleDirections(centres, bilinear, FlowField::SampleMode::BILINEAR);
+
+    for (int index = 0; index < width * height; index++)
+    {
+        sf::Vector2f direction(flowField.getTile(index % width, index / width).flowDirection);
+        float length = std::sqrt(direction.x * direction.x + direction.y * direction.y);
+        if (length > 0.0f)
+            direction /= length;
+
+        const float TOLERANCE = 0.001f;
+        sf::Vector2f nearestError = nearest[index] - direction;
+        sf::Vector2f bilinearError = bilinear[index] - direction;
+
+        if (std::abs(nearestError.x) > TOLERANCE || std::abs(nearestError.y) > TOLERANCE ||
+            std::abs(bilinearError.x) > TOLERANCE || std::abs(bilinearError.y) > TOLERANCE)
+        {
+            std::ostringstream message;
+            message << "sampled direction at (" << index % width << ", " << index / width << ") does not match the field";
+            reportFailure(mapName, message.str());
+            return false;
+        }
+    }
+
+    // Following the directions from any reachable tile must reach the goal without looping
+    std::vector<int> visitedBy(width * height, -1);
+
+    for (int startIndex = 0; startIndex < width * height; startIndex++)
+    {
+        if (expected[startIndex] <= 0)
+            continue;
+
+        int x = startIndex % width;
+        int y = startIndex / width;
+        int pathCost = 0;
+
+        while (x != goal.x || y != goal.y)
+        {
+            visitedBy[y * width + x] = startIndex;
+            sf::Vector2i direction = flowField.getTile(x, y).flowDirection;
+
+            std::ostringstream message;
+            message << "walk from (" << startIndex % width << ", " << startIndex / width << ") ";
+
+            if (direction.x == 0 && direction.y == 0)
+            {
+                message << "dead ends at (" << x << ", " << y << ")";
+                reportFailure(mapName, message.str());
+                return false;
+            }
+
+            int nextX = x + direction.x;
+            int nextY = y + direction.y;
+
+            bool diagonalBlocked = direction.x != 0 && direction.y != 0 &&
+                (!isOpen(x + direction.x, y) || !isOpen(x, y + direction.y));
+
+            if (!isOpen(nextX, nextY) || diagonalBlocked)
+            {
+                message << "steps into blocked tile (" << nextX << ", " << nextY << ")";
+                reportFailure(mapName, message.str());
+                return false;
+            }
+
+            if (visitedBy[nextY * width + nextX] == startIndex)
+            {
+                message << "loops at (" << nextX << ", " << nextY << ")";
+                reportFailure(mapName, message.str());
+                return false;
+            }
+
+            // Costs are accumulated outward from the goal, so each tile charges for leaving it
+            pathCost += weighted ? flowField.getTile(x, y).terrainCost + flowField.getDynamicCost(x, y) +
+                                   flowField.getSoftCost(x, y) : 1;
+            x = nextX;
+            y = nextY;
+        }
+
+        worstStretch = std::max(worstStretch, static_cast<float>(pathCost) / expected[startIndex]);
+    }
+
+    if (worstStretch > MAX_PATH_STRETCH)
+    {
+        std::ostringstream message;
+        message << "followed path is " << worstStretch << "x the optimal cost";
+        reportFailure(mapName, message.str());
+    }
+
+    // The extracted start path has to exist exactly when the start can reach the goal
+    const std::vector<sf::Vector2i>& path = flowField.getShortestPath();
+    if (!path.empty() && path.back() != goal)
+    {
+        reportFailure(mapName, "shortest path does not end at the goal");
+    }
+
+    return failures == failuresBefore;
+}
+
+bool FlowFieldValidator::checkPathTree(const FlowField& flowField, const std::string& mapName)
+{
+    const int START_COUNT = 200;
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    sf::Vector2i goal = flowField.getGoalTile();
+
+    // Random tiles, blocked and unreachable ones included, with some starts repeated
+    std::vector<sf::Vector2i> starts;
+    for (int i = 0; i < START_COUNT; i++)
+    {
+        starts.push_back(i % 10 == 9 ? starts[rng() % starts.size()]
+                                     : sf::Vector2i(rng() % width, rng() % height));
+    }
+
+    PathTree tree = flowField.extractPaths(starts);
+    std::map<std::pair<int, int>, int> distinctTiles;
+
+    for (int i = 0; i < START_COUNT; i++)
+    {
+        // Reference: walk the directions from this start alone
+        std::vector<sf::Vector2i> expected{ starts[i] };
+        while (expected.back() != goal && static_cast<int>(expected.size()) <= width * height)
+        {
+            sf::Vector2i direction = flowField.getTile(expected.back().x, expected.back().y).flowDirection;
+            if ((direction.x == 0 && direction.y == 0) ||
+                flowField.getTile(expected.back().x, expected.back().y).terrainCost == OBSTACLE)
+                break;
+
+            expected.push_back(expected.back() + direction);
+        }
+
+        if (expected.back() != goal)
+        {
+            expected.clear();
+        }
+
+        if (tree.getPath(i) != expected)
+        {
+            std::ostringstream message;
+            message << "path tree path from (" << starts[i].x << ", " << starts[i].y << ") has " << tree.getPath(i).size()
+                    << " tiles, walking the field gives " << expected.size();
+            reportFailure(mapName, message.str());
+            return false;
+        }
+
+        for (sf::Vector2i tile : expected)
+        {
+            distinctTiles[{ tile.x, tile.y }]++;
+        }
+    }
+
+    // Shared suffixes are stored once
+    if (tree.nodes.size() > std::max<size_t>(1, distinctTiles.size()))
+    {
+        reportFailure(mapName, "path tree stores some tiles more than once");
+        return false;
+    }
+
+    return true;
+}
+
+bool FlowFieldValidator::checkGridRaycaster(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                                            const std::string& mapName)
+{
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    GridRaycaster raycaster(width, height, terrain);
+
+    // Brute force reference: the first obstacle whose closed box the segment touches, found by
+    // clipping against every box. Returns the entry fraction, or 2 when nothing is touched.
+    // 'grow' widens the boxes, so rays that only just miss or touch a corner can be told apart.
+    auto firstTouch = [&](sf::Vector2f from, sf::Vector2f to, double grow)
+    {
+        double dx = static_cast<double>(to.x) - from.x;
+        double dy = static_cast<double>(to.y) - from.y;
+        double first = 2.0;
+
+        for (int y = -1; y <= height; y++)
+        {
+            for (int x = -1; x <= width; x++)
+            {
+                bool offGrid = x < 0 || x >= width || y < 0 || y >= height;
+                if (!offGrid && flowField.getTile(x, y).terrainCost != OBSTACLE)
+                    continue;
+
+                double enter = 0.0;
+                double leave = 1.0;
+                const double deltas[2] = { dx, dy };
+                const double starts[2] = { static_cast<double>(from.x) - x, static_cast<double>(from.y) - y };
+
+                for (int axis = 0; axis < 2 && enter <= leave; axis++)
+                {
+                    if (deltas[axis] == 0.0)
+                    {
+                        if (starts[axis] < -grow || starts[axis] > 1.0 + grow)
+                            leave = -1.0;
+                        continue;
+                    }
+
+                    double low = (-grow - starts[axis]) / deltas[axis];
+                    double high = (1.0 + grow - starts[axis]) / deltas[axis];
+                    enter = std::max(enter, std::min(low, high));
+                    leave = std::min(leave, std::max(low, high));
+                }
+
+                if (enter <= leave)
+                    first = std::min(first, enter);
+            }
+        }
+        return first;
+    };
+
+    auto checkRay = [&](const GridRaycaster::Ray& ray, const GridRaycaster::RayHit& hit, const char* kind)
+    {
+        double touch = firstTouch(ray.from, ray.to, 1e-9);
+
+        // Skip rays within rounding of grazing a box, the reference cannot call those either way
+        if ((touch <= 1.0) != (firstTouch(ray.from, ray.to, -1e-5) <= 1.0))
+            return true;
+
+        std::ostringstream message;
+        message << kind << " ray (" << ray.from.x << ", " << ray.from.y << ") to (" << ray.to.x << ", " << ray.to.y << ") ";
+
+        if (hit.blocked != (touch <= 1.0))
+        {
+            message << (hit.blocked ? "is blocked but clear" : "is clear but blocked");
+            reportFailure(mapName, message.str());
+            return false;
+        }
+
+        if (hit.blocked && (!raycaster.isBlocked(hit.tile.x, hit.tile.y) || std::abs(hit.fraction - touch) > 1e-4))
+        {
+            message << "hit (" << hit.tile.x << ", " << hit.tile.y << ") at " << hit.fraction << ", expected an obstacle at " << touch;
+            reportFailure(mapName, message.str());
+            return false;
+        }
+        return true;
+    };
+
+    // Rays between arbitrary points, and between tile centres, which pass exactly through corners
+    std::uniform_real_distribution<float> coordinateX(0.0f, static_cast<float>(width));
+    std::uniform_real_distribution<float> coordinateY(0.0f, static_cast<float>(height));
+    std::vector<GridRaycaster::Ray> rays;
+
+    for (int i = 0; i < 200; i++)
+    {
+        if (i % 2 == 0)
+        {
+            rays.push_back({ { coordinateX(rng), coordinateY(rng) }, { coordinateX(rng), coordinateY(rng) } });
+        }
+        else
+        {
+            sf::Vector2i from = randomOpenTile(flowField);
+            sf::Vector2i to = randomOpenTile(flowField);
+            rays.push_back({ { from.x + 0.5f, from.y + 0.5f }, { to.x + 0.5f, to.y + 0.5f } });
+        }
+
+        if (!checkRay(rays.back(), raycaster.cast(rays.back().from, rays.back().to), i % 2 == 0 ? "free" : "centre"))
+            return false;
+    }
+
+    // A batch big enough to be split over threads has to match the single casts
+    while (rays.size() < 3 * 2048)
+    {
+        rays.push_back(rays[rays.size() % 200]);
+    }
+
+    std::vector<GridRaycaster::RayHit> hits;
+    raycaster.castRays(rays, hits, 4);
+
+    for (size_t i = 0; i < rays.size(); i++)
+    {
+        GridRaycaster::RayHit single = raycaster.cast(rays[i].from, rays[i].to);
+        if (hits[i].blocked != single.blocked || hits[i].tile != single.tile || hits[i].fraction != single.fraction)
+        {
+            std::ostringstream message;
+            message << "batched ray " << i << " differs from the single cast";
+            reportFailure(mapName, message.str());
+            return false;
+        }
+    }
+
+    // Every leg of the smoothed path has to be clear, and it must still start and end in place
+    const std::vector<sf::Vector2i>& path = flowField.getShortestPath();
+    std::vector<sf::Vector2i> smoothed = raycaster.smoothPath(path);
+
+    if (!path.empty() && (smoothed.front() != path.front() || smoothed.back() != path.back()))
+    {
+        reportFailure(mapName, "smoothed path moved its ends");
+        return false;
+    }
+
+    for (size_t i = 1; i < smoothed.size(); i++)
+    {
+        if (!raycaster.isClear(smoothed[i - 1], smoothed[i]))
+        {
+            std::ostringstream message;
+            message << "smoothed path leg (" << smoothed[i - 1].x << ", " << smoothed[i - 1].y << ") to ("
+                    << smoothed[i].x << ", " << smoothed[i].y << ") is blocked";
+            reportFailure(mapName, message.str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FlowFieldValidator::checkQuadtreeField(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                                            const std::string& mapName)
+{
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    sf::Vector2i goal = flowField.getGoalTile();
+
+    QuadtreeField quadtree(width, height, terrain);
+    if (!quadtree.setGoalTile(goal))
+    {
+        reportFailure(mapName, "quadtree refused an open goal");
+        return false;
+    }
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int expected = flowField.getTile(x, y).cost;
+            int bound = quadtree.getCost(x, y);
+
+            // Same reachable tiles, and the block bound never undercuts the true distance
+            if ((expected < 0) != (bound < 0) || bound < expected)
+            {
+                std::ostringstream message;
+                message << "quadtree cost at (" << x << ", " << y << ") is " << bound << ", true cost " << expected;
+                reportFailure(mapName, message.str());
+                return false;
+            }
+
+            if (bound < 0)
+                continue;
+
+            // Following the block directions reaches the goal with legal moves within the bound
+            sf::Vector2i position(x, y);
+            int steps = 0;
+
+            while (position != goal && steps <= bound)
+            {
+                sf::Vector2i direction = quadtree.getFlowDirection(position.x, position.y);
+                sf::Vector2i next = position + direction;
+
+                bool legal = (direction.x != 0 || direction.y != 0) &&
+                             next.x >= 0 && next.x < width && next.y >= 0 && next.y < height &&
+                             flowField.getTile(next.x, next.y).terrainCost != OBSTACLE &&
+                             flowField.getTile(position.x + direction.x, position.y).terrainCost != OBSTACLE &&
+                             flowField.getTile(position.x, position.y + direction.y).terrainCost != OBSTACLE;
+                if (!legal)
+                {
+                    std::ostringstream message;
+                    message << "quadtree direction at (" << position.x << ", " << position.y << ") is not a legal move";
+                    reportFailure(mapName, message.str());
+                    return false;
+                }
+
+                position = next;
+                steps++;
+            }
+
+            if (position != goal)
+            {
+                std::ostringstream message;
+                message << "following the quadtree from (" << x << ", " << y << ") takes more than " << bound << " steps";
+                reportFailure(mapName, message.str());
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool FlowFieldValidator::checkLineOfSight(FlowField& flowField, const std::string& mapName)
+{
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    sf::Vector2i goal = flowField.getGoalTile();
+    flowField.setLineOfSightEnabled(true);
+
+    // Brute force reference: the line between tile centres must not touch any tile without a cost,
+    // corners included. Tile (x, y) covers [x - 0.5, x + 0.5] x [y - 0.5, y + 0.5] here.
+    auto lineIsClear = [&](sf::Vector2i from)
+    {
+        double dx = goal.x - from.x;
+        double dy = goal.y - from.y;
+
+        for (int y = std::min(from.y, goal.y); y <= std::max(from.y, goal.y); y++)
+        {
+            for (int x = std::min(from.x, goal.x); x <= std::max(from.x, goal.x); x++)
+            {
+                if (flowField.getTile(x, y).cost >= 0)
+                    continue;
+
+                // Clip the line against the tile's box
+                double enter = 0.0;
+                double leave = 1.0;
+                const double deltas[2] = { dx, dy };
+                const double starts[2] = { static_cast<double>(from.x - x), static_cast<double>(from.y - y) };
+
+                for (int axis = 0; axis < 2 && enter <= leave + 1e-9; axis++)
+                {
+                    if (deltas[axis] == 0.0)
+                    {
+                        if (std::abs(starts[axis]) > 0.5)
+                            leave = -1.0;
+                        continue;
+                    }
+
+                    double first = (-0.5 - starts[axis]) / deltas[axis];
+                    double second = (0.5 - starts[axis]) / deltas[axis];
+                    enter = std::max(enter, std::min(first, second));
+                    leave = std::min(leave, std::max(first, second));
+                }
+
+                if (enter <= leave + 1e-9)
+                    return false;
+            }
+        }
+        return true;
+    };
+
+    sf::Vector2f goalCentre = flowField.getTileCenter(goal.x, goal.y);
+    std::vector<sf::Vector2f> centres;
+    std::vector<sf::Vector2i> seenTiles;
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (!flowField.hasLineOfSight(x, y))
+                continue;
+
+            if (!lineIsClear({ x, y }))
+            {
+                std::ostringstream message;
+                message << "tile (" << x << ", " << y << ") sees the goal through a wall";
+                reportFailure(mapName, message.str());
+                flowField.setLineOfSightEnabled(false);
+                return false;
+            }
+
+            centres.push_back(flowField.getTileCenter(x, y));
+            seenTiles.push_back({ x, y });
+        }
+    }
+
+    // Straight neighbours of the goal always see it
+    for (int n = 0; n < 4; n++)
+    {
+        sf::Vector2i tile = goal + sf::Vector2i(n < 2 ? n * 2 - 1 : 0, n < 2 ? 0 : n * 2 - 5);
+        if (tile.x >= 0 && tile.x < width && tile.y >= 0 && tile.y < height &&
+            flowField.getTile(tile.x, tile.y).cost >= 0 && !flowField.hasLineOfSight(tile.x, tile.y))
+        {
+            reportFailure(mapName, "open tile next to the goal does not see it");
+            flowField.setLineOfSightEnabled(false);
+            return false;
+        }
+    }
+
+    // Tiles in sight steer straight at the goal
+    std::vector<sf::Vector2f> directions;
+    flowField.sampleDirections(centres, directions, FlowField::SampleMode::NEAREST);
+
+    for (size_t i = 0; i < centres.size(); i++)
+    {
+        sf::Vector2f toGoal = goalCentre - centres[i];
+        float length = std::sqrt(toGoal.x * toGoal.x + toGoal.y * toGoal.y);
+        sf::Vector2f expected = length > 0.0f ? toGoal / length : sf::Vector2f(0.0f, 0.0f);
+
+        if (std::abs(directions[i].x - expected.x) > 1e-4f || std::abs(directions[i].y - expected.y) > 1e-4f)
+        {
+            std::ostringstream message;
+            message << "tile (" << seenTiles[i].x << ", " << seenTiles[i].y << ") in sight does not steer at the goal";
+            reportFailure(mapName, message.str());
+            flowField.setLineOfSightEnabled(false);
+            return false;
+        }
+    }
+
+    // Incremental updates only redo the rings that can have changed, so they have to leave the
+    // same flags as a full rebuild
+    auto matchesRebuild = [&](const char* update)
+    {
+        std::vector<bool> seen(width * height);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                seen[y * width + x] = flowField.hasLineOfSight(x, y);
+            }
+        }
+
+        flowField.setLineOfSightEnabled(false);
+        flowField.setLineOfSightEnabled(true);
+
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                if (seen[y * width + x] != flowField.hasLineOfSight(x, y))
+                {
+                    std::ostringstream message;
+                    message << "tile (" << x << ", " << y << ") line of sight is stale after " << update;
+                    reportFailure(mapName, message.str());
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    // Soft costs: the first row makes the field weighted, the next two are repaired in place
+    int softRow = static_cast<int>(rng() % height);
+    std::vector<std::uint8_t> rowCosts(width, 0);
+    bool matched = true;
+
+    for (int softCost : { 3, 9, 0 })
+    {
+        std::fill(rowCosts.begin(), rowCosts.end(), static_cast<std::uint8_t>(softCost));
+        flowField.setSoftCostRows(softRow, 1, rowCosts.data());
+        matched = matched && matchesRebuild("a soft cost repair");
+    }
+
+    // A bounded field resumed for agents further out reaches tiles that were walls to it before
+    std::vector<sf::Vector2i> agents{ randomOpenTile(flowField) };
+    flowField.setGoalTileBounded(goal, agents, BOUNDED_MARGIN);
+    matched = matched && matchesRebuild("a bounded field");
+
+    for (int i = 0; i < 8; i++)
+    {
+        agents.push_back(randomOpenTile(flowField));
+    }
+    flowField.expandCostField(agents);
+    matched = matched && matchesRebuild("a bounded expansion");
+
+    flowField.setGoalTile(goal);
+    flowField.setLineOfSightEnabled(false);
+    return matched;
+}
+
+bool FlowFieldValidator::checkFieldBroker(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                                          const std::string& mapName)
+{
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    FlowField generator(width, height, 60.0f);
+    generator.loadTerrain(terrain);
+    FlowFieldBroker broker(generator);
+
+    sf::Vector2i goal = randomOpenTile(generator);
+    int fieldId = broker.acquire(goal, 1);
+    if (fieldId < 0)
+    {
+        reportFailure(mapName, "broker refused an open goal");
+        return false;
+    }
+
+    std::vector<int> expected = referenceCosts(generator, goal, false);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (broker.getCost(fieldId, x, y) != expected[y * width + x])
+            {
+                std::ostringstream message;
+                message << "brokered cost at (" << x << ", " << y << ") is " << broker.getCost(fieldId, x, y)
+                        << ", expected " << expected[y * width + x];
+                reportFailure(mapName, message.str());
+                return false;
+            }
+        }
+    }
+
+    // The same goal, and an open neighbour one step away, must share the field
+    std::vector<int> agentFields{ fieldId, broker.acquire(goal, 1) };
+    for (int dy = -1; dy <= 1 && agentFields.size() < 3; dy++)
+    {
+        for (int dx = -1; dx <= 1 && agentFields.size() < 3; dx++)
+        {
+            if ((dx != 0 || dy != 0) && broker.getCost(fieldId, goal.x + dx, goal.y + dy) == 1)
+            {
+                agentFields.push_back(broker.acquire(goal + sf::Vector2i(dx, dy), 1));
+            }
+        }
+    }
+
+    for (int agentField : agentFields)
+    {
+        if (agentField != fieldId)
+        {
+            reportFailure(mapName, "broker built a second field for a shared goal");
+            return false;
+        }
+    }
+
+    // A field that is still in use survives releases, the last release frees it
+    for (int agentField : agentFields)
+    {
+        if (broker.getField(fieldId) == nullptr)
+        {
+            reportFailure(mapName, "broker released a field that was still in use");
+            return false;
+        }
+        broker.release(agentField);
+    }
+
+    if (broker.getField(fieldId) != nullptr || broker.getStats().liveFields != 0 || broker.getStats().fieldsBuilt != 1)
+    {
+        reportFailure(mapName, "broker field count is wrong after releasing every agent");
+        return false;
+    }
+
+    // A goal on the generator's start tile is still an open goal
+    sf::Vector2i start = randomOpenTile(generator);
+    if (!generator.setStartTile(start))
+        return true;
+
+    int startField = broker.acquire(start, 1);
+    if (startField < 0 || broker.getCost(startField, start.x, start.y) != 0)
+    {
+        reportFailure(mapName, "broker refused a goal on the generator's start tile");
+        return false;
+    }
+
+    return true;
+}
+
+bool FlowFieldValidator::checkJobScheduler(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                                           const std::string& mapName)
+{
+    const int REQUESTER = 7;
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    FieldJobScheduler scheduler(width, height, terrain, 2);
+
+    // The first background job holds the shared worker in its callback until everything else is
+    // queued, which makes the order deterministic and checks that player jobs still get through
+    std::promise<void> started;
+    std::promise<void> gate;
+    std::shared_future<void> gateOpen = gate.get_future().share();
+    std::vector<FieldJobTicket> background{ scheduler.submit(randomOpenTile(flowField), 1, FieldJobPriority::BACKGROUND,
+        FieldJobScheduler::Clock::time_point::max(), -1, [&started, gateOpen](const FieldJobResult&)
+        {
+            started.set_value();
+            gateOpen.wait();
+        }) };
+    started.get_future().wait();
+
+    for (int i = 0; i < 3; i++)
+    {
+        background.push_back(scheduler.submit(randomOpenTile(flowField), 1, FieldJobPriority::BACKGROUND));
+    }
+
+    FieldJobTicket superseded = scheduler.submit(randomOpenTile(flowField), 1, FieldJobPriority::AI,
+                                                 FieldJobScheduler::Clock::time_point::max(), REQUESTER);
+    sf::Vector2i goal = randomOpenTile(flowField);
+    FieldJobTicket latest = scheduler.submit(goal, 1, FieldJobPriority::PLAYER,
+                                             FieldJobScheduler::Clock::time_point::max(), REQUESTER);
+    FieldJobTicket cancelled = scheduler.submit(randomOpenTile(flowField), 1, FieldJobPriority::BACKGROUND);
+    scheduler.cancel(cancelled.id);
+
+    const FieldJobResult& result = latest.result.get();
+    gate.set_value();
+
+    if (result.status != FieldJobResult::Status::BUILT)
+    {
+        reportFailure(mapName, "player job was not built");
+        return false;
+    }
+
+    std::vector<int> expected = referenceCosts(flowField, goal, false);
+    for (int i = 0; i < width * height; i++)
+    {
+        if (result.costs[i] != expected[i])
+        {
+            std::ostringstream message;
+            message << "scheduled cost at (" << i % width << ", " << i / width << ") is " << result.costs[i]
+                    << ", expected " << expected[i];
+            reportFailure(mapName, message.str());
+            return false;
+        }
+    }
+
+    if (superseded.result.get().status != FieldJobResult::Status::CANCELLED)
+    {
+        reportFailure(mapName, "superseded job still delivered a field");
+        return false;
+    }
+
+    FieldJobResult::Status cancelledStatus = cancelled.result.get().status;
+    if (cancelledStatus != FieldJobResult::Status::CANCELLED)
+    {
+        reportFailure(mapName, "cancelled job still delivered a field");
+        return false;
+    }
+
+    for (FieldJobTicket& ticket : background)
+    {
+        if (ticket.result.get().status != FieldJobResult::Status::BUILT)
+        {
+            reportFailure(mapName, "background job was not built");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FlowFieldValidator::checkCooperativePlanner(const FlowField& flowField, const std::string& mapName)
+{
+    int width = flowField.getGridWidth();
+    CooperativePlanner planner(flowField);
+
+    int furthestCost = 0;
+    for (int attempt = 0; attempt < SQUAD_SIZE * 5 && planner.getAgentCount() < SQUAD_SIZE; attempt++)
+    {
+        sf::Vector2i tile = randomOpenTile(flowField);
+        if (tile.x >= 0 && planner.addAgent(tile) >= 0)
+        {
+            furthestCost = std::max(furthestCost, flowField.getTile(tile.x, tile.y).cost);
+        }
+    }
+
+    int agentCount = planner.getAgentCount();
+    std::vector<int> previous(agentCount);
+    for (int agent = 0; agent < agentCount; agent++)
+    {
+        previous[agent] = planner.getAgentTile(agent).y * width + planner.getAgentTile(agent).x;
+    }
+
+    // Agents reach the goal one at a time, so the last one may queue behind the whole squad
+    int tickLimit = 2 * (furthestCost + agentCount) + 20;
+    while (planner.getStats().arrived < agentCount && planner.getTick() < tickLimit)
+    {
+        std::vector<bool> moving(agentCount);
+        for (int agent = 0; agent < agentCount; agent++)
+        {
+            moving[agent] = !planner.hasArrived(agent);
+        }
+
+        planner.update();
+
+        std::map<int, int> occupied;
+        std::vector<int> current(agentCount);
+
+        for (int agent = 0; agent < agentCount; agent++)
+        {
+            sf::Vector2i tile = planner.getAgentTile(agent);
+            current[agent] = tile.y * width + tile.x;
+
+            if (!moving[agent])
+                continue;
+
+            int dx = tile.x - previous[agent] % width;
+            int dy = tile.y - previous[agent] / width;
+            if (std::abs(dx) > 1 || std::abs(dy) > 1 || flowField.getTile(tile.x, tile.y).cost < 0)
+            {
+                reportFailure(mapName, "squad agent made an illegal move");
+                return false;
+            }
+
+            if (!occupied.emplace(current[agent], agent).second)
+            {
+                std::ostringstream message;
+                message << "two squad agents share (" << tile.x << ", " << tile.y << ") at tick " << planner.getTick();
+                reportFailure(mapName, message.str());
+                return false;
+            }
+        }
+
+        for (int agent = 0; agent < agentCount; agent++)
+        {
+            auto other = occupied.find(previous[agent]);
+            if (moving[agent] && current[agent] != previous[agent] && other != occupied.end() &&
+                other->second != agent && previous[other->second] == current[agent])
+            {
+                reportFailure(mapName, "two squad agents swapped tiles");
+                return false;
+            }
+        }
+
+        previous = current;
+    }
+
+    if (planner.getStats().arrived != agentCount)
+    {
+        std::ostringstream message;
+        message << planner.getStats().arrived << " of " << agentCount << " squad agents arrived within "
+                << tickLimit << " ticks";
+        reportFailure(mapName, message.str());
+        return false;
+    }
+
+    return true;
+}
+
+bool FlowFieldValidator::checkCrowdSeparation(const FlowField& flowField, const std::string& mapName)
+{
+    const int PASSES = 8;
+    const int THREADED_AGENTS = 10000;
+
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    float tileSize = flowField.getTileCenter(1, 0).x - flowField.getTileCenter(0, 0).x;
+    CrowdSeparation separation(tileSize * 0.3f);
+
+    auto isWalkable = [&](sf::Vector2f position)
+    {
+        sf::Vector2i tile = flowField.worldToGrid(position);
+        return tile.x >= 0 && tile.x < width && tile.y >= 0 && tile.y < height &&
+               flowField.getTile(tile.x, tile.y).terrainCost != OBSTACLE;
+    };
+
+    // Agents stacked two or three to a tile centre, like a crowd that has been following the field
+    int openTiles = 0;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            openTiles += flowField.getTile(x, y).terrainCost != OBSTACLE;
+        }
+    }
+
+    std::vector<sf::Vector2f> crowd;
+    while (static_cast<int>(crowd.size()) < openTiles / 2)
+    {
+        sf::Vector2i tile = randomOpenTile(flowField);
+        int stacked = 2 + static_cast<int>(rng() % 2);
+        for (int i = 0; i < stacked; i++)
+        {
+            crowd.push_back(flowField.getTileCenter(tile.x, tile.y));
+        }
+    }
+
+    // Neighbour queries must match a brute force search
+    separation.build(crowd);
+    std::uniform_real_distribution<float> offset(-tileSize, tileSize);
+    std::vector<int> neighbours;
+
+    for (int query = 0; query < 20; query++)
+    {
+        sf::Vector2f position = crowd[rng() % crowd.size()] + sf::Vector2f(offset(rng), offset(rng));
+        float radius = tileSize * (0.5f + static_cast<float>(rng() % 3));
+        separation.findNeighbours(crowd, position, radius, neighbours);
+        std::sort(neighbours.begin(), neighbours.end());
+
+        std::vector<int> expected;
+        for (int i = 0; i < static_cast<int>(crowd.size()); i++)
+        {
+            sf::Vector2f away = crowd[i] - position;
+            if (away.x * away.x + away.y * away.y <= radius * radius)
+                expected.push_back(i);
+        }
+
+        if (neighbours != expected)
+        {
+            std::ostringstream message;
+            message << "query at (" << position.x << ", " << position.y << ") found " << neighbours.size()
+                    << " neighbours, expected " << expected.size();
+            reportFailure(mapName, message.str());
+            return false;
+        }
+    }
+
+    // Separation passes must thin out the overlaps without pushing anyone into a wall
+    separation.resolve(crowd, flowField, 1);
+    int firstOverlaps = separation.getStats().overlaps;
+    separation.resolve(crowd, flowField, PASSES);
+    int lastOverlaps = separation.getStats().overlaps;
+
+    for (sf::Vector2f position : crowd)
+    {
+        if (!isWalkable(position))
+        {
+            std::ostringstream message;
+            message << "agent pushed into a wall at (" << position.x << ", " << position.y << ")";
+            reportFailure(mapName, message.str());
+            return false;
+        }
+    }
+
+    if (firstOverlaps > 0 && lastOverlaps >= firstOverlaps)
+    {
+        std::ostringstream message;
+        message << "overlaps went from " << firstOverlaps << " to " << lastOverlaps << " after " << PASSES << " passes";
+        reportFailure(mapName, message.str());
+        return false;
+    }
+
+    // A crowd big enough to be split over threads must come out the same as on one thread
+    std::uniform_real_distribution<float> coordinateX(0.0f, width * tileSize);
+    std::uniform_real_distribution<float> coordinateY(0.0f, height * tileSize);
+    std::vector<sf::Vector2f> single;
+
+    for (int i = 0; i < THREADED_AGENTS; i++)
+    {
+        single.push_back(flowField.gridToWorld(0, 0) + sf::Vector2f(coordinateX(rng), coordinateY(rng)));
+    }
+
+    std::vector<sf::Vector2f> threaded = single;
+    separation.resolve(single, flowField, 1, 1);
+    separation.resolve(threaded, flowField, 1, 4);
+
+    if (single != threaded)
+    {
+        reportFailure(mapName, "threaded separation differs from a single thread");
+        return false;
+    }
+
+    return true;
+}
+
+bool FlowFieldValidator::checkFormationNavigator(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                                                 const std::string& mapName)
+{
+    const float TICK_SECONDS = 0.1f;
+    const int SETTLE_TICKS = 50;
+
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    GridRaycaster raycaster(width, height, terrain);
+    FormationNavigator navigator(flowField, raycaster);
+
+    // A finger four and a wide line, from tiles that can reach the goal
+    std::vector<std::vector<sf::Vector2f>> shapes = { FormationNavigator::getFingerFourOffsets(2.0f),
+                                                      { { -3.0f, 0.0f }, { -1.5f, 0.0f }, { 0.0f, 0.0f },
+                                                        { 1.5f, 0.0f }, { 3.0f, 0.0f } } };
+    int longestCost = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        sf::Vector2i start = randomOpenTile(flowField);
+        if (navigator.addFormation(start, shapes[i % shapes.size()]) >= 0)
+        {
+            longestCost = std::max(longestCost, flowField.getTile(start.x, start.y).cost);
+        }
+    }
+
+    auto isReachable = [&](sf::Vector2f position)
+    {
+        int x = static_cast<int>(std::floor(position.x));
+        int y = static_cast<int>(std::floor(position.y));
+        return x >= 0 && x < width && y >= 0 && y < height && flowField.getTile(x, y).cost >= 0;
+    };
+
+    // Anchors move at least a tile per second along paths no longer than sqrt(2) per cost step
+    int tickLimit = static_cast<int>(longestCost * 1.5f / TICK_SECONDS) + SETTLE_TICKS;
+
+    for (int tick = 0; tick < tickLimit; tick++)
+    {
+        navigator.update(TICK_SECONDS);
+
+        for (int formation = 0; formation < navigator.getFormationCount(); formation++)
+        {
+            sf::Vector2f anchor = navigator.getAnchor(formation);
+
+            for (int slot = 0; slot < navigator.getSlotCount(formation); slot++)
+            {
+                sf::Vector2f position = navigator.getSlotPosition(formation, slot);
+                sf::Vector2f member = navigator.getMemberPosition(formation, slot);
+                float spread = navigator.getSlotSpread(formation, slot);
+
+                std::ostringstream message;
+                message << "tick " << tick << ", formation " << formation << " slot " << slot << " ";
+
+                // Slots have to be walkable and in plain sight of the anchor, members always on open ground
+                if (!isReachable(position) || !raycaster.isClear(anchor, position))
+                {
+                    message << "at (" << position.x << ", " << position.y << ") is blocked or hidden from the anchor";
+                    reportFailure(mapName, message.str());
+                    return false;
+                }
+
+                if (!isReachable(member))
+                {
+                    message << "member at (" << member.x << ", " << member.y << ") is off the walkable tiles";
+                    reportFailure(mapName, message.str());
+                    return false;
+                }
+
+                if (spread < 0.0f || spread > 1.0f)
+                {
+                    message << "has spread " << spread;
+                    reportFailure(mapName, message.str());
+                    return false;
+                }
+            }
+        }
+    }
+
+    if (navigator.getStats().arrived != navigator.getFormationCount())
+    {
+        std::ostringstream message;
+        message << navigator.getStats().arrived << " of " << navigator.getFormationCount()
+                << " formations reached the goal in " << tickLimit << " ticks";
+        reportFailure(mapName, message.str());
+        return false;
+    }
+
+    return true;
+}
+
+bool FlowFieldValidator::checkFieldCache(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                                         const std::string& mapName)
+{
+    FieldCache cache(getCacheDirectory());
+    cache.store(flowField);
+    cache.waitForWrites();
+
+    FlowField restored(flowField.getGridWidth(), flowField.getGridHeight(), 60.0f);
+    restored.loadTerrain(terrain);
+
+    if (!cache.load(restored, flowField.getGoalTile()))
+    {
+        reportFailure(mapName, "field was not found in the cache");
+        return false;
+    }
+
+    for (int y = 0; y < flowField.getGridHeight(); y++)
+    {
+        for (int x = 0; x < flowField.getGridWidth(); x++)
+        {
+            const Tile& expected = flowField.getTile(x, y);
+            const Tile& tile = restored.getTile(x, y);
+
+            if (tile.cost != expected.cost || tile.integrationCost != expected.integrationCost ||
+                tile.flowDirection != expected.flowDirection)
+            {
+                std::ostringstream message;
+                message << "cached tile (" << x << ", " << y << ") differs from the generated one";
+                reportFailure(mapName, message.str());
+                return false;
+            }
+        }
+    }
+
+    // A different goal on the same terrain must miss
+    sf::Vector2i otherGoal = randomOpenTile(restored);
+    if (otherGoal != flowField.getGoalTile() && cache.load(restored, otherGoal))
+    {
+        reportFailure(mapName, "cache returned a field for a goal that was never stored");
+        return false;
+    }
+
+    // Nor may a field stored with diagonal moves come back once they are turned off
+    FlowField connected(flowField.getGridWidth(), flowField.getGridHeight(), 60.0f);
+    connected.loadTerrain(terrain);
+    connected.setConnectivity(FlowField::Connectivity::EIGHT);
+
+    if (connected.setGoalTile(flowField.getGoalTile()))
+    {
+        cache.store(connected);
+        cache.waitForWrites();
+        connected.setConnectivity(FlowField::Connectivity::FOUR);
+
+        if (cache.load(connected, flowField.getGoalTile()))
+        {
+            reportFailure(mapName, "cache returned an eight connected field for a four connected grid");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::string FlowFieldValidator::getCacheDirectory()
+{
+    return (std::filesystem::temp_directory_path() / "flowfield_validator_cache").string();
+}
+
+bool FlowFieldValidator::checkMultiGoalFields(const FlowField& flowField, const std::string& mapName)
+{
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+
+    std::vector<sf::Vector2i> goals{ flowField.getGoalTile() };
+    for (int i = 0; i < 4; i++)
+    {
+        goals.push_back(randomOpenTile(flowField));
+    }
+
+    MultiGoalFields fields = flowField.createMultiGoalFields(goals);
+
+    for (int goal = 0; goal < static_cast<int>(goals.size()); goal++)
+    {
+        std::vector<int> expected = referenceCosts(flowField, goals[goal], false);
+
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                std::ostringstream message;
+                message << "goal " << goal << " at (" << x << ", " << y << ") ";
+
+                if (fields.getCost(x, y, goal) != expected[y * width + x])
+                {
+                    message << "has cost " << fields.getCost(x, y, goal) << ", expected " << expected[y * width + x];
+                    reportFailure(mapName, message.str());
+                    return false;
+                }
+
+                // The first goal is the one the flowfield itself holds, so every value has to match it
+                const Tile& tile = flowField.getTile(x, y);
+                if (goal == 0 && (fields.getIntegrationCost(x, y, goal) != tile.integrationCost ||
+                                  fields.getFlowDirection(x, y, goal) != tile.flowDirection))
+                {
+                    message << "differs from the single goal field";
+                    reportFailure(mapName, message.str());
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool FlowFieldValidator::checkUnitSizes(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                                        const std::string& mapName)
+{
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    sf::Vector2i goal = flowField.getGoalTile();
+
+    auto isOpen = [&](int x, int y)
+    {
+        return x >= 0 && x < width && y >= 0 && y < height && terrain[y * width + x] != OBSTACLE;
+    };
+
+    FlowField sized(width, height, 60.0f);
+    sized.loadTerrain(terrain);
+
+    for (int size = 1; size <= 4; size++)
+    {
+        // A unit of this size on tile (x, y) covers x - (size - 1) / 2 to x + size / 2 on each axis,
+        // so even sizes reach one tile further right and down than left and up
+        std::vector<bool> fits(width * height, false);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                bool clear = true;
+                for (int footY = y - (size - 1) / 2; footY <= y + size / 2 && clear; footY++)
+                {
+                    for (int footX = x - (size - 1) / 2; footX <= x + size / 2 && clear; footX++)
+                    {
+                        clear = isOpen(footX, footY);
+                    }
+                }
+                fits[y * width + x] = clear;
+            }
+        }
+
+        // Breadth first over the tiles the unit fits on. A diagonal step also needs the unit to fit
+        // on both tiles beside it, or its footprint would sweep across the corner between them.
+        std::vector<int> expected(width * height, -1);
+        std::queue<int> open;
+        if (fits[goal.y * width + goal.x])
+        {
+            expected[goal.y * width + goal.x] = 0;
+            open.push(goal.y * width + goal.x);
+        }
+
+        while (!open.empty())
+        {
+            int index = open.front();
+            open.pop();
+            int x = index % width;
+            int y = index / width;
+
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    int nextX = x + dx;
+                    int nextY = y + dy;
+
+                    if ((dx == 0 && dy == 0) || nextX < 0 || nextX >= width || nextY < 0 || nextY >= height ||
+                        !fits[nextY * width + nextX] || expected[nextY * width + nextX] != -1)
+                    {
+                        continue;
+                    }
+
+                    if (dx != 0 && dy != 0 && (!fits[y * width + nextX] || !fits[nextY * width + x]))
+                        continue;
+
+                    expected[nextY * width + nextX] = expected[index] + 1;
+                    open.push(nextY * width + nextX);
+                }
+            }
+        }
+
+        sized.setUnitSize(size);
+        sized.setGoalTile(goal);
+
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                if (sized.getTile(x, y).cost != expected[y * width + x])
+                {
+                    std::ostringstream message;
+                    message << "size " << size << " tile (" << x << ", " << y << ") has cost " << sized.getTile(x, y).cost
+                            << ", expected " << expected[y * width + x];
+                    reportFailure(mapName, message.str());
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool FlowFieldValidator::checkUnitSizeGaps()
+{
+    // A wall across the map with one gap: each size class fits through gaps its own width and
+    // wider and no narrower ones, so all four classes stay distinct
+    const int WIDTH = 12;
+    const int HEIGHT = 10;
+    const int WALL_Y = 4;
+    const int GAP_X = 4;
+    const sf::Vector2i GOAL(5, 1);
+    const sf::Vector2i START(5, 7);
+
+    for (int gap = 1; gap <= 4; gap++)
+    {
+        std::vector<std::uint8_t> terrain(WIDTH * HEIGHT, 1);
+        for (int x = 0; x < WIDTH; x++)
+        {
+            if (x < GAP_X || x >= GAP_X + gap)
+            {
+                terrain[WALL_Y * WIDTH + x] = OBSTACLE;
+            }
+        }
+
+        FlowField flowField(WIDTH, HEIGHT, 60.0f);
+        flowField.loadTerrain(terrain);
+
+        for (int size = 1; size <= 4; size++)
+        {
+            flowField.setUnitSize(size);
+            flowField.setGoalTile(GOAL);
+
+            bool reached = flowField.getTile(START.x, START.y).cost >= 0;
+            if (reached != (size <= gap))
+            {
+                std::ostringstream name;
+                name << "unit size gaps (gap " << gap << ")";
+                std::ostringstream message;
+                message << "size " << size << (reached ? " fits through" : " does not fit through") << " the gap";
+                reportFailure(name.str(), message.str());
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool FlowFieldValidator::checkBoundedField(FlowField& flowField, const std::string& mapName)
+{
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    sf::Vector2i goal = flowField.getGoalTile();
+    std::vector<int> expected = referenceCosts(flowField, goal, false);
+
+    std::vector<sf::Vector2i> agents;
+    for (int i = 0; i < 4; i++)
+    {
+        agents.push_back(randomOpenTile(flowField));
+    }
+    flowField.setGoalTileBounded(goal, agents, BOUNDED_MARGIN);
+
+    // Every agent must carry its optimal cost and be able to walk to the goal, after the first
+    // bounded pass and again after new agents further out force the wavefront to resume
+    for (int pass = 0; pass < 2; pass++)
+    {
+        if (pass == 1)
+        {
+            std::vector<sf::Vector2i> newAgents;
+            for (int i = 0; i < 8; i++)
+            {
+                newAgents.push_back(randomOpenTile(flowField));
+            }
+            flowField.expandCostField(newAgents);
+            agents.insert(agents.end(), newAgents.begin(), newAgents.end());
+        }
+
+        for (sf::Vector2i agent : agents)
+        {
+            int cost = flowField.getTile(agent.x, agent.y).cost;
+            int expectedCost = expected[agent.y * width + agent.x];
+
+            std::ostringstream message;
+            message << "agent at (" << agent.x << ", " << agent.y << ") ";
+
+            if (cost != expectedCost)
+            {
+                message << "has cost " << cost << ", expected " << expectedCost;
+                reportFailure(mapName, message.str());
+                return false;
+            }
+
+            sf::Vector2i position = agent;
+            for (int steps = 0; expectedCost > 0 && position != goal; steps++)
+            {
+                sf::Vector2i direction = flowField.getTile(position.x, position.y).flowDirection;
+
+                if ((direction.x == 0 && direction.y == 0) || steps > width * height)
+                {
+                    message << "cannot walk to the goal from (" << position.x << ", " << position.y << ")";
+                    reportFailure(mapName, message.str());
+                    return false;
+                }
+                position += direction;
+            }
+        }
+    }
+
+    // Back to a complete field for the remaining checks
+    flowField.setGoalTile(goal);
+    return true;
+}
+
+bool FlowFieldValidator::checkInfluenceMap(FlowField& flowField, const std::string& mapName)
+{
+    const float SOFT_COST_WEIGHT = 6.0f;
+
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    InfluenceMap influenceMap(width, height, 4, 0.7f);
+
+    struct PlacedStamp
+    {
+        int id;
+        InfluenceMap::Layer layer;
+        sf::Vector2i tile;
+        float strength;
+    };
+    std::vector<PlacedStamp> placed;
+
+    std::uniform_real_distribution<float> strength(0.5f, 4.0f);
+    for (int i = 0; i < 12; i++)
+    {
+        InfluenceMap::Layer layer = i % 3 == 0 ? InfluenceMap::Layer::UNITS : InfluenceMap::Layer::THREATS;
+        sf::Vector2i tile(static_cast<int>(rng() % width), static_cast<int>(rng() % height));
+        float value = strength(rng);
+        placed.push_back({ influenceMap.addStamp(layer, tile, value), layer, tile, value });
+    }
+
+    // Brute force sum of every stamp's kernel, compared against the propagated layers
+    auto checkLayers = [&](const char* stage)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                float expected[2] = { 0.0f, 0.0f };
+                for (const PlacedStamp& stamp : placed)
+                {
+                    int dx = std::abs(stamp.tile.x - x);
+                    int dy = std::abs(stamp.tile.y - y);
+                    if (dx <= influenceMap.getRadius() && dy <= influenceMap.getRadius())
+                    {
+                        expected[static_cast<int>(stamp.layer)] += stamp.strength * std::pow(influenceMap.getDecay(), static_cast<float>(dx + dy));
+                    }
+                }
+
+                for (InfluenceMap::Layer layer : { InfluenceMap::Layer::UNITS, InfluenceMap::Layer::THREATS })
+                {
+                    float influence = influenceMap.getInfluence(layer, x, y);
+                    if (std::abs(influence - expected[static_cast<int>(layer)]) > 1e-3f)
+                    {
+                        std::ostringstream message;
+                        message << stage << ": influence at (" << x << ", " << y << ") is " << influence
+                                << ", expected " << expected[static_cast<int>(layer)];
+                        reportFailure(mapName, message.str());
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    };
+
+    // Soft costs must follow the threat layer, and the field must be optimal with them added
+    auto checkSoftCosts = [&](const char* stage)
+    {
+        influenceMap.applySoftCost(flowField, InfluenceMap::Layer::THREATS, SOFT_COST_WEIGHT);
+
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                float threat = SOFT_COST_WEIGHT * influenceMap.getInfluence(InfluenceMap::Layer::THREATS, x, y);
+                int expected = std::clamp(static_cast<int>(threat), 0, InfluenceMap::MAX_SOFT_COST);
+
+                if (flowField.getSoftCost(x, y) != expected)
+                {
+                    std::ostringstream message;
+                    message << stage << ": soft cost at (" << x << ", " << y << ") is "
+                            << flowField.getSoftCost(x, y) << ", expected " << expected;
+                    reportFailure(mapName, message.str());
+                    return false;
+                }
+            }
+        }
+        return checkField(flowField, mapName + " " + stage, true);
+    };
+
+    influenceMap.update();
+    if (!checkLayers("stamped") || !checkSoftCosts("stamped"))
+        return false;
+
+    // Move, reweight and drop a few stamps, so only some rows are propagated again
+    for (int i = 0; i < 4; i++)
+    {
+        PlacedStamp& stamp = placed[rng() % placed.size()];
+        stamp.tile = sf::Vector2i(static_cast<int>(rng() % width), static_cast<int>(rng() % height));
+        influenceMap.moveStamp(stamp.id, stamp.tile);
+    }
+    placed[0].strength = strength(rng);
+    influenceMap.setStampStrength(placed[0].id, placed[0].strength);
+    influenceMap.removeStamp(placed.back().id);
+    placed.pop_back();
+
+    influenceMap.update();
+    if (!checkLayers("moved") || !checkSoftCosts("moved"))
+        return false;
+
+    // Clearing every stamp takes the soft costs back off the field
+    influenceMap.clear();
+    influenceMap.applySoftCost(flowField, InfluenceMap::Layer::THREATS, SOFT_COST_WEIGHT);
+
+    if (flowField.hasSoftCost())
+    {
+        reportFailure(mapName, "soft costs left behind after clearing the influence map");
+        return false;
+    }
+
+    // Rows written from above the grid drop the source rows cut off, row 0 gets the second one
+    std::vector<std::uint8_t> rows(2 * width, 7);
+    std::fill(rows.begin() + width, rows.end(), 5);
+    flowField.setSoftCostRows(-1, 2, rows.data());
+    bool clipped = flowField.getSoftCost(0, 0) == 5 && flowField.getSoftCost(0, 1) == 0;
+
+    std::fill(rows.begin(), rows.end(), 0);
+    flowField.setSoftCostRows(0, 1, rows.data());
+
+    if (!clipped || flowField.hasSoftCost())
+    {
+        reportFailure(mapName, "soft cost rows above the grid were not clipped");
+        return false;
+    }
+    return true;
+}
+
+std::vector<int> FlowFieldValidator::referenceCosts(const FlowField& flowField, sf::Vector2i goal, bool weighted) const
+{
+    // Straightforward Dijkstra over the same movement rules, kept independent of FlowField's code
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+    std::vector<int> costs(width * height, -1);
+    bool diagonals = flowField.getConnectivity() == FlowField::Connectivity::EIGHT;
+
+    auto isOpen = [&](int x, int y)
+    {
+        return x >= 0 && x < width && y >= 0 && y < height && flowField.getTile(x, y).terrainCost != OBSTACLE;
+    };
+
+    if (!isOpen(goal.x, goal.y))
+        return costs;
+
+    using Entry = std::pair<int, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+    costs[goal.y * width + goal.x] = 0;
+    open.push({ 0, goal.y * width + goal.x });
+
+    while (!open.empty())
+    {
+        auto [cost, index] = open.top();
+        open.pop();
+
+        if (cost != costs[index])
+            continue;
+
+        int x = index % width;
+        int y = index / width;
+
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                if ((dx == 0 && dy == 0) || !isOpen(x + dx, y + dy))
+                    continue;
+
+                if (dx != 0 && dy != 0 && (!diagonals || !isOpen(x + dx, y) || !isOpen(x, y + dy)))
+                    continue;
+
+                int step = weighted ? flowField.getTile(x + dx, y + dy).terrainCost + flowField.getDynamicCost(x + dx, y + dy) +
+                                      flowField.getSoftCost(x + dx, y + dy) : 1;
+                int neighbourIndex = (y + dy) * width + x + dx;
+
+                if (costs[neighbourIndex] == -1 || cost + step < costs[neighbourIndex])
+                {
+                    costs[neighbourIndex] = cost + step;
+                    open.push({ cost + step, neighbourIndex });
+                }
+            }
+        }
+    }
+
+    return costs;
+}
+
+void FlowFieldValidator::splatRandomAgents(FlowField& flowField, int agentCount)
+{
+    std::vector<sf::Vector2f> positions;
+    std::vector<sf::Vector2f> velocities;
+    std::uniform_real_distribution<float> velocity(-60.0f, 60.0f);
+
+    for (int i = 0; i < agentCount; i++)
+    {
+        sf::Vector2i tile = randomOpenTile(flowField);
+        positions.push_back(flowField.getTileCenter(tile.x, tile.y));
+        velocities.push_back({ velocity(rng), velocity(rng) });
+    }
+
+    flowField.updateDynamicCost(positions, velocities);
+}
+
+sf::Vector2i FlowFieldValidator::randomOpenTile(const FlowField& flowField)
+{
+    int width = flowField.getGridWidth();
+    int height = flowField.getGridHeight();
+
+    for (int attempt = 0; attempt < 1000; attempt++)
+    {
+        int x = static_cast<int>(rng() % width);
+        int y = static_cast<int>(rng() % height);
+
+        if (flowField.getTile(x, y).terrainCost != OBSTACLE)
+            return { x, y };
+    }
+
+    // Almost closed maps: take the first open tile from a random point on
+    int first = static_cast<int>(rng() % (width * height));
+    for (int i = 0; i < width * height; i++)
+    {
+        int index = (first + i) % (width * height);
+        if (flowField.getTile(index % width, index / width).terrainCost != OBSTACLE)
+            return { index % width, index / width };
+    }
+
+    return { -1, -1 };
+}
+
+void FlowFieldValidator::reportFailure(const std::string& mapName, const std::string& message)
+{
+    failures++;
+    std::cout << "FAIL " << mapName << ": " << message << std::endl;
+}
+
+float FlowFieldValidator::getBenchmarkDensity(MapGenerator::Family family)
+{
+    switch (family)
+    {
+    case MapGenerator::Family::MAZE:  return 0.1f;
+    case MapGenerator::Family::CAVES: return 0.45f;
+    case MapGenerator::Family::ROOMS: return 0.3f;
+    case MapGenerator::Family::OPEN:  return 0.05f;
+    default:                          return 0.2f;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef FLOWFIELDVALIDATOR_HPP
+#define FLOWFIELDVALIDATOR_HPP
+
+#include <SFML/Graphics.hpp>
+#include <random>
+#include <string>
+#include <vector>
+#include "MapGenerator.h"
+
+class FlowField;
+
+// Headless checks for FlowField: generates random maps, compares the generated fields against a
+// reference Dijkstra and times each stage against stored baselines
+class FlowFieldValidator
+{
+public:
+    explicit FlowFieldValidator(unsigned int seed = 1);
+
+    // Returns true when every generated map produced correct fields
+    bool runCorrectness(int mapCount);
+
+    // Returns true when no stage got slower than its baseline by more than the threshold.
+    // Missing baselines are written from this run.
+    bool runBenchmark(const std::string& baselinePath, float threshold = 0.25f);
+
+private:
+    static constexpr int OBSTACLE = 255;
+    static constexpr float MAX_PATH_STRETCH = 1.5f;     // Allowed ratio of followed path cost to optimal cost
+    static constexpr int BOUNDED_MARGIN = 3;            // Cost steps past the furthest agent for bounded fields
+    static constexpr int SQUAD_SIZE = 20;               // Agents in the cooperative planner check
+
+    std::mt19937 rng;
+    int failures = 0;
+
+    bool checkField(const FlowField& flowField, const std::string& mapName, bool weighted);
+    bool checkBoundedField(FlowField& flowField, const std::string& mapName);
+    bool checkUnitSizes(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                        const std::string& mapName);
+    bool checkUnitSizeGaps();
+    bool checkInfluenceMap(FlowField& flowField, const std::string& mapName);
+    bool checkLineOfSight(FlowField& flowField, const std::string& mapName);
+    bool checkPathTree(const FlowField& flowField, const std::string& mapName);
+    bool checkGridRaycaster(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                            const std::string& mapName);
+    bool checkQuadtreeField(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                            const std::string& mapName);
+    bool checkMultiGoalFields(const FlowField& flowField, const std::string& mapName);
+    bool checkFieldBroker(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                          const std::string& mapName);
+    bool checkJobScheduler(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                           const std::string& mapName);
+    bool checkCooperativePlanner(const FlowField& flowField, const std::string& mapName);
+    bool checkCrowdSeparation(const FlowField& flowField, const std::string& mapName);
+    bool checkFormationNavigator(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                                 const std::string& mapName);
+    bool checkFieldCache(const FlowField& flowField, const std::vector<std::uint8_t>& terrain,
+                         const std::string& mapName);
+    std::vector<int> referenceCosts(const FlowField& flowField, sf::Vector2i goal, bool weighted) const;
+    void splatRandomAgents(FlowField& flowField, int agentCount);
+    sf::Vector2i randomOpenTile(const FlowField& flowField);
+    void reportFailure(const std::string& mapName, const std::string& message);
+    static float getBenchmarkDensity(MapGenerator::Family family);
+    static std::string getCacheDirectory();
+};
+
+#endif
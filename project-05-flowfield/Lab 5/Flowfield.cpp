@@ -1,52 +1,62 @@
 #include "FlowField.h"
+#include "MapGenerator.h"
 #include <iostream>
 #include <string>
 #include <queue>
 #include <cmath>
+#include <thread>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <limits>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 FlowField::FlowField(int w, int h, float size)
-    : gridWidth(w), gridHeight(h), tileSize(size)
+    : tileSize(size)
 {
-    grid.resize(gridHeight, std::vector<Tile>(gridWidth));
+    resizeGrid(w, h);
+    createHeatmapLut();
 
-    tileShapes.reserve(gridWidth * gridHeight);
-    for (int y = 0; y < gridHeight; y++)
-    {
-        for (int x = 0; x < gridWidth; x++)
-        {
-            sf::RectangleShape rect(sf::Vector2f(tileSize - 2.0f, tileSize - 2.0f));
-            rect.setPosition({ x * tileSize + UI_WIDTH, y * tileSize });
-            rect.setFillColor(sf::Color(70, 70, 70));
-            rect.setOutlineColor(sf::Color(40, 40, 40));
-            rect.setOutlineThickness(1.0f);
-            tileShapes.push_back(rect);
-        }
-    }
-
-    UIBox.setSize(sf::Vector2f(UI_WIDTH, gridHeight * tileSize));
     UIBox.setPosition(sf::Vector2f(0.0f, 0.0f));
     UIBox.setFillColor(sf::Color(40, 40, 50, 255));
     UIBox.setOutlineColor(sf::Color(100, 100, 120));
     UIBox.setOutlineThickness(2.0f);
 
-    instructionsText.setCharacterSize(48);
+    instructionsText.setCharacterSize(36);
     instructionsText.setFillColor(sf::Color(220, 220, 220));
     instructionsText.setOutlineColor(sf::Color::Black);
     instructionsText.setOutlineThickness(2.0f);
     instructionsText.setPosition({ 10.0f, 10.0f });
     instructionsText.setString(
         "Flowfield Pathfinding\n\nInstructions:\n\n"
-        " - Set goal node\n\twith left click\n\n"
-        " - Set start node\n\twith right click\n\n"
-        " - Toggle obstacle\n\twith middle click\n\n"
-        " - Start/Reset NPC\n\twith 'Spacebar'\n\n"
-		" NOTE:\n\tNPC only moves if\n\tstart and goal set\n\n"
-        " - Toggle cost field\n\twith '1'\n\n"
-        " - Toggle heatmap\n\twith '2'\n\n"
-        " - Toggle integration\n\twith '3'\n\n"
-        " - Toggle vector field\n\twith '4'\n\n"
+        " - Set goal node\n\twith left click\n"
+        " - Set start node\n\twith right click\n"
+        " - Toggle obstacle\n\twith middle click\n"
+        " - Start/Reset NPC\n\twith 'Spacebar'\n"
+		" NOTE:\n\tNPC only moves if\n\tstart and goal set\n"
+        " - Toggle cost field\n\twith '1'\n"
+        " - Toggle heatmap\n\twith '2'\n"
+        " - Toggle integration\n\twith '3'\n"
+        " - Toggle vector field\n\twith '4'\n"
+        " - Cycle unit size (1-4)\n\twith '5'\n"
+        " - Toggle stats panel\n\twith '6'\n"
+        " - Save stats to CSV\n\twith '7'\n"
+        " - Toggle fixed-point\n\tintegration with '8'\n"
+        " - Toggle 4/8 neighbours\n\twith '9'\n"
+        " - Toggle line of sight\n\twith 'L'\n"
+        " - Smooth field view\n\twith 'S'\n"
+        " - Pan / zoom view\n\tarrows, mouse wheel\n"
+        " - Reset view\n\twith '0'\n"
     );
 
+    statsText.setCharacterSize(26);
+    statsText.setFillColor(sf::Color(220, 220, 220));
+    statsText.setOutlineColor(sf::Color::Black);
+    statsText.setOutlineThickness(1.0f);
+    statsText.setPosition({ 10.0f, 10.0f });
+
     costText.setCharacterSize(28);
     costText.setFillColor(sf::Color::White);
     costText.setOutlineColor(sf::Color::Black);
@@ -61,86 +71,465 @@ FlowField::FlowField(int w, int h, float size)
     initializeTerrain();
 }
 
+void FlowField::resizeGrid(int w, int h)
+{
+    gridWidth = w;
+    gridHeight = h;
+    stride = w + 2;
+
+    // The grid carries a one tile border of permanent obstacles so neighbour loops never leave it
+    int paddedTileCount = stride * (gridHeight + 2);
+    grid.assign(paddedTileCount, Tile());
+    for (Tile& tile : grid)
+    {
+        tile.terrainCost = 255;
+    }
+
+    for (int i = 0; i < NEIGHBOUR_COUNT; i++)
+    {
+        neighbourOffset[i] = DY[i] * stride + DX[i];
+    }
+
+    densityField.assign(paddedTileCount, 0.0f);
+    dynamicCost.assign(paddedTileCount, 0);
+    softCost.assign(paddedTileCount, 0);
+    softCostTiles = 0;
+    costParent.assign(paddedTileCount, -1);
+    clearance.assign(paddedTileCount, 0);
+    lineOfSight.assign(paddedTileCount, 0);
+    componentParent.assign(paddedTileCount, -1);
+
+    // Until the first render, assume the window was sized to fit the whole grid next to the UI
+    windowSize = sf::Vector2f(UI_WIDTH + gridWidth * tileSize, gridHeight * tileSize);
+    resetCamera();
+
+    UIBox.setSize(sf::Vector2f(UI_WIDTH, gridHeight * tileSize));
+    fieldTextureDirty = true;
+    terrainHashDirty = true;
+}
+
 void FlowField::initializeTerrain()
 {
     for (int y = 0; y < gridHeight; y++)
     {
         for (int x = 0; x < gridWidth; x++)
         {
-            grid[y][x].terrainCost = 1; // Normal passable tile
+            tileAt(x, y).terrainCost = 1; // Normal passable tile
         }
     }
 
     // Create a vertical wall
     for (int y = 10; y < 20; y++)
     {
-        grid[y][25].terrainCost = 255;
+        if (isValid(25, y))
+            tileAt(25, y).terrainCost = 255;
     }
 
     // Create a horizontal wall
     for (int x = 10; x < 20; x++)
     {
-        grid[25][x].terrainCost = 255;
+        if (isValid(x, 25))
+            tileAt(x, 25).terrainCost = 255;
     }
+
+    createClearanceField();
+    createComponents();
+    terrainHashDirty = true;
 }
 
-void FlowField::createCostField()
+void FlowField::createComponents()
 {
-    // Reset all path distances
+    // Diagonal moves need both adjacent tiles to be open, so 4-connectivity gives the same regions
     for (int y = 0; y < gridHeight; y++)
     {
         for (int x = 0; x < gridWidth; x++)
         {
-            grid[y][x].cost = -1;
+            int index = tileIndex(x, y);
+
+            if (tileIsObstacle(x, y))
+            {
+                componentParent[index] = -1;
+                continue;
+            }
+
+            componentParent[index] = index;
+
+            // The border is never open, so the left and upper tiles can be read unchecked
+            if (grid[index - 1].terrainCost != 255)
+                mergeComponents(index, index - 1);
+
+            if (grid[index - stride].terrainCost != 255)
+                mergeComponents(index, index - stride);
+        }
+    }
+}
+
+void FlowField::updateComponents(int x, int y)
+{
+    int index = tileIndex(x, y);
+
+    if (!tileIsObstacle(x, y))
+    {
+        // Opening a tile can only join regions together
+        if (componentParent[index] == -1)
+        {
+            componentParent[index] = index;
+        }
+        else
+        {
+            // Reopening a dead link left by an earlier close keeps its old region, which is only
+            // right if it still borders that region
+            int region = findComponent(index);
+            bool bordersRegion = false;
+
+            for (int i = 0; i < 4; i++)
+            {
+                int neighbour = index + neighbourOffset[i];
+
+                if (grid[neighbour].terrainCost != 255 && findComponent(neighbour) == region)
+                {
+                    bordersRegion = true;
+                }
+            }
+
+            if (!bordersRegion)
+            {
+                createComponents();
+                return;
+            }
+        }
+
+        for (int i = 0; i < 4; i++)
+        {
+            int neighbour = index + neighbourOffset[i];
+
+            if (grid[neighbour].terrainCost != 255)
+            {
+                mergeComponents(index, neighbour);
+            }
         }
+        return;
     }
 
-    // Validate goal position
+    // Closing a tile leaves it in the forest as a dead link, which is harmless while its region
+    // stays in one piece. Union-find cannot split sets, so a real split needs a full relabel.
+    if (closingSplitsRegion(x, y))
+    {
+        createComponents();
+    }
+}
+
+bool FlowField::closingSplitsRegion(int x, int y) const
+{
+    // Walk the ring of 8 tiles around (x, y). Consecutive ring tiles touch each other, so open tiles
+    // form runs around the ring; if every open edge neighbour sits in the same run they stay connected.
+    static constexpr int RING_X[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+    static constexpr int RING_Y[8] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+
+    bool open[8];
+    for (int i = 0; i < 8; i++)
+    {
+        open[i] = !tileIsObstacle(x + RING_X[i], y + RING_Y[i]);
+    }
+
+    // Start from a closed tile so runs never wrap around the start of the walk
+    int start = -1;
+    for (int i = 0; i < 8; i++)
+    {
+        if (!open[i])
+        {
+            start = i;
+            break;
+        }
+    }
+
+    if (start == -1)
+        return false;
+
+    int runsWithEdgeNeighbour = 0;
+    bool runHasEdgeNeighbour = false;
+
+    for (int step = 1; step <= 8; step++)
+    {
+        int i = (start + step) % 8;
+
+        if (open[i])
+        {
+            runHasEdgeNeighbour = runHasEdgeNeighbour || (i % 2 == 0);
+        }
+        else
+        {
+            if (runHasEdgeNeighbour)
+                runsWithEdgeNeighbour++;
+
+            runHasEdgeNeighbour = false;
+        }
+    }
+
+    return runsWithEdgeNeighbour > 1;
+}
+
+int FlowField::findComponent(int index) const
+{
+    // Path halving keeps the trees flat so lookups stay effectively constant time
+    while (componentParent[index] != index)
+    {
+        componentParent[index] = componentParent[componentParent[index]];
+        index = componentParent[index];
+    }
+    return index;
+}
+
+void FlowField::mergeComponents(int first, int second)
+{
+    int firstRoot = findComponent(first);
+    int secondRoot = findComponent(second);
+
+    if (firstRoot != secondRoot)
+    {
+        componentParent[std::max(firstRoot, secondRoot)] = std::min(firstRoot, secondRoot);
+    }
+}
+
+bool FlowField::isReachable(sf::Vector2i from, sf::Vector2i to) const
+{
+    if (!isValid(from.x, from.y) || !isValid(to.x, to.y))
+        return false;
+
+    if (tileIsObstacle(from.x, from.y) || tileIsObstacle(to.x, to.y))
+        return false;
+
+    return findComponent(tileIndex(from.x, from.y)) == findComponent(tileIndex(to.x, to.y));
+}
+
+void FlowField::createClearanceField()
+{
+    // Two pass chamfer distance transform. With unit weights on all 8 neighbours this gives the
+    // exact Chebyshev distance to the nearest obstacle. The border tiles keep a clearance of 0,
+    // so the map edge counts as an obstacle without any bounds checks.
+    for (int y = 0; y < gridHeight; y++)
+    {
+        for (int index = tileIndex(0, y); index <= tileIndex(gridWidth - 1, y); index++)
+        {
+            if (grid[index].terrainCost == 255)
+            {
+                clearance[index] = 0;
+                continue;
+            }
+
+            int nearest = std::min({ clearance[index - 1], clearance[index - stride - 1],
+                                     clearance[index - stride], clearance[index - stride + 1] });
+            clearance[index] = static_cast<std::uint8_t>(std::min(MAX_CLEARANCE, nearest + 1));
+        }
+    }
+
+    for (int y = gridHeight - 1; y >= 0; y--)
+    {
+        for (int index = tileIndex(gridWidth - 1, y); index >= tileIndex(0, y); index--)
+        {
+            if (grid[index].terrainCost == 255)
+                continue;
+
+            int nearest = std::min({ clearance[index + 1], clearance[index + stride + 1],
+                                     clearance[index + stride], clearance[index + stride - 1] });
+            clearance[index] = static_cast<std::uint8_t>(std::min<int>(clearance[index], nearest + 1));
+        }
+    }
+}
+
+void FlowField::updateClearance(int x, int y)
+{
+    // Only tiles whose nearest obstacle changes are affected, and they form a solid square around
+    // the edited tile: an opened tile can only raise tiles whose clearance equalled their distance
+    // to it, a closed tile can only lower tiles whose clearance was larger than their distance to it.
+    // Clearance changes by at most 1 between neighbours, so the first ring with no such tile ends the scan.
+    bool opened = !tileIsObstacle(x, y);
+    int radius = 0;
+
+    for (int ring = 1; ring <= MAX_CLEARANCE; ring++)
+    {
+        bool ringAffected = false;
+
+        for (int ringY = y - ring; ringY <= y + ring && !ringAffected; ringY++)
+        {
+            int step = (ringY == y - ring || ringY == y + ring) ? 1 : ring * 2;
+
+            for (int ringX = x - ring; ringX <= x + ring; ringX += step)
+            {
+                if (!isValid(ringX, ringY))
+                    continue;
+
+                int oldClearance = clearance[tileIndex(ringX, ringY)];
+                if ((opened && oldClearance == ring) || (!opened && oldClearance > ring))
+                {
+                    ringAffected = true;
+                    break;
+                }
+            }
+        }
+
+        if (!ringAffected)
+            break;
+
+        radius = ring;
+    }
+
+    // Rebuild the affected square with a bucketed wavefront seeded from its border, which is unchanged
+    int minX = std::max(0, x - radius);
+    int maxX = std::min(gridWidth - 1, x + radius);
+    int minY = std::max(0, y - radius);
+    int maxY = std::min(gridHeight - 1, y + radius);
+
+    std::vector<std::vector<int>> buckets(MAX_CLEARANCE + 1);
+
+    for (int tileY = minY; tileY <= maxY; tileY++)
+    {
+        for (int tileX = minX; tileX <= maxX; tileX++)
+        {
+            int index = tileIndex(tileX, tileY);
+
+            if (tileIsObstacle(tileX, tileY))
+            {
+                clearance[index] = 0;
+                continue;
+            }
+
+            int nearest = MAX_CLEARANCE;
+            for (int i = 0; i < NEIGHBOUR_COUNT; i++)
+            {
+                int neighbourX = tileX + DX[i];
+                int neighbourY = tileY + DY[i];
+
+                if (tileIsObstacle(neighbourX, neighbourY))
+                {
+                    nearest = 0;
+                }
+                else if (neighbourX < minX || neighbourX > maxX || neighbourY < minY || neighbourY > maxY)
+                {
+                    nearest = std::min<int>(nearest, clearance[tileIndex(neighbourX, neighbourY)]);
+                }
+            }
+
+            clearance[index] = static_cast<std::uint8_t>(std::min(MAX_CLEARANCE, nearest + 1));
+            buckets[clearance[index]].push_back(index);
+        }
+    }
+
+    for (int value = 1; value < MAX_CLEARANCE; value++)
+    {
+        for (size_t i = 0; i < buckets[value].size(); i++)
+        {
+            int index = buckets[value][i];
+            if (clearance[index] != value)
+                continue;
+
+            int tileX = indexToX(index);
+            int tileY = indexToY(index);
+
+            for (int n = 0; n < NEIGHBOUR_COUNT; n++)
+            {
+                int neighbourX = tileX + DX[n];
+                int neighbourY = tileY + DY[n];
+
+                if (neighbourX < minX || neighbourX > maxX || neighbourY < minY || neighbourY > maxY)
+                    continue;
+
+                int neighbourIndex = tileIndex(neighbourX, neighbourY);
+                if (clearance[neighbourIndex] > value + 1)
+                {
+                    clearance[neighbourIndex] = static_cast<std::uint8_t>(value + 1);
+                    buckets[value + 1].push_back(neighbourIndex);
+                }
+            }
+        }
+    }
+}
+
+void FlowField::createCostField()
+{
+    ScopedStageTimer timer(stats, FlowFieldStats::Stage::COST_FIELD);
+    stats.counters.tilesVisited = 0;
+    stats.counters.queuePushes = 0;
+
+    // Reset all path distances
+    for (Tile& tile : grid)
+    {
+        tile.cost = -1;
+    }
+
+    costFieldBounded = false;
+    expandedTiles.clear();
+    costFrontier = CostQueue();
+
+    // Validate goal position, the goal also has to fit the current unit size
     if (!isValid(goalPosition.x, goalPosition.y) ||
-        grid[goalPosition.y][goalPosition.x].terrainCost == 255)
+        !tileIsPassable(goalPosition.x, goalPosition.y))
     {
         return;
     }
 
-    grid[goalPosition.y][goalPosition.x].cost = 0;
+    int goalIndex = tileIndex(goalPosition.x, goalPosition.y);
+    grid[goalIndex].cost = 0;
     maxCostValue = 0;
 
-    // BFS to generate costs
-    std::queue<sf::Vector2i> validTiles;
-    validTiles.push(goalPosition);
+    // Congestion and soft costs make steps uneven, so the wavefront needs Dijkstra instead of BFS
+    if (hasStepCosts())
+    {
+        createWeightedCostField();
+        return;
+    }
+
+    if (connectivity == Connectivity::FOUR)
+    {
+        sweepCostField<FourConnected>(goalIndex);
+    }
+    else
+    {
+        sweepCostField<EightConnected>(goalIndex);
+    }
+}
+
+template <typename Neighbourhood>
+void FlowField::sweepCostField(int goalIndex)
+{
+    // BFS to generate costs. The obstacle border means neighbours never need bounds checks.
+    std::queue<int> validTiles;
+    validTiles.push(goalIndex);
+    stats.counters.queuePushes++;
 
     while (!validTiles.empty())
     {
-        sf::Vector2i current = validTiles.front();
+        int current = validTiles.front();
         validTiles.pop();
+        stats.counters.tilesVisited++;
 
-        int currentCost = grid[current.y][current.x].cost;
+        int currentCost = grid[current].cost;
 
-        for (int i = 0; i < NEIGHBOUR_COUNT; i++)
+        for (int i = 0; i < Neighbourhood::COUNT; i++)
         {
-            int neighbourX = current.x + DX[i];
-            int neighbourY = current.y + DY[i];
+            int neighbour = current + neighbourOffset[i];
 
-            if (!isValid(neighbourX, neighbourY))
+            if (!tileIsPassable(neighbour))
                 continue;
 
-            if (grid[neighbourY][neighbourX].terrainCost == 255)
-                continue;
-
-            if (isDiagonalBlocked(current.x, current.y, neighbourX, neighbourY))
-                continue;
+            if constexpr (Neighbourhood::HAS_DIAGONALS)
+            {
+                if (isDiagonalBlocked(current, i))
+                    continue;
+            }
 
             // BUSHFIRE: All neighbouring tiles get +1 regardless of direction
-            if (grid[neighbourY][neighbourX].cost == -1)
+            if (grid[neighbour].cost == -1)
             {
-                grid[neighbourY][neighbourX].cost = currentCost + 1;
+                grid[neighbour].cost = currentCost + 1;
 
-                if (grid[neighbourY][neighbourX].cost > maxCostValue)
+                if (grid[neighbour].cost > maxCostValue)
                 {
-                    maxCostValue = grid[neighbourY][neighbourX].cost;
+                    maxCostValue = grid[neighbour].cost;
                 }
 
-                validTiles.push(sf::Vector2i(neighbourX, neighbourY));
+                validTiles.push(neighbour);
+                stats.counters.queuePushes++;
             }
         }
     }
@@ -148,314 +537,1765 @@ void FlowField::createCostField()
 
 void FlowField::createIntegrationField()
 {
+    ScopedStageTimer timer(stats, FlowFieldStats::Stage::INTEGRATION_FIELD);
+
     // Validate goal position
     if (!isValid(goalPosition.x, goalPosition.y))
         return;
 
-    // Calculate integration costs: cost field + Euclidean distance to goal
+    bool fixed = integrationMode == IntegrationMode::FIXED_OCTILE;
+
+    if (connectivity == Connectivity::FOUR)
+    {
+        fixed ? integrateField<FourConnected, FixedOctileMetric>() : integrateField<FourConnected, EuclideanMetric>();
+    }
+    else
+    {
+        fixed ? integrateField<EightConnected, FixedOctileMetric>() : integrateField<EightConnected, EuclideanMetric>();
+    }
+
+    createLineOfSight();
+}
+
+template <typename Neighbourhood, typename Metric>
+void FlowField::integrateField()
+{
+    // Calculate integration costs: cost field + distance to goal
     for (int y = 0; y < gridHeight; y++)
     {
         for (int x = 0; x < gridWidth; x++)
         {
+            Tile& tile = tileAt(x, y);
+
             // Skip unreachable tiles and obstacles
-            if (grid[y][x].cost == -1 || grid[y][x].terrainCost == 255)
+            if (tile.cost == -1 || tile.terrainCost == 255)
             {
-                grid[y][x].integrationCost = -1.0f;
-                grid[y][x].flowDirection = { 0, 0 };
+                tile.integrationCost = -1;
+                tile.flowDirection = { 0, 0 };
                 continue;
             }
 
-            // Calculate Euclidean distance from this tile to goal
-            float dx = static_cast<float>(x - goalPosition.x);
-            float dy = static_cast<float>(y - goalPosition.y);
-            float euclideanDist = std::sqrt(dx * dx + dy * dy);
-
-            // Integration = cost field + Euclidean distance (scaled for visibility)
-			// cost field is in steps, so scale by tileSize to match Euclidean distance scale
-            grid[y][x].integrationCost = grid[y][x].cost * tileSize + static_cast<int>(euclideanDist * tileSize);
+            tile.integrationCost = Metric::getIntegrationCost(tile.cost, x - goalPosition.x, y - goalPosition.y, tileSize);
         }
     }
 
     for (int y = 0; y < gridHeight; y++)
     {
-        for (int x = 0; x < gridWidth; x++)
+        for (int index = tileIndex(0, y); index <= tileIndex(gridWidth - 1, y); index++)
         {
-            if (grid[y][x].integrationCost >= 0.0f)
+            if (grid[index].integrationCost >= 0)
             {
-                grid[y][x].flowDirection = getFlowDirection(x, y);
+                grid[index].flowDirection = getFlowDirection<Neighbourhood>(index);
             }
         }
     }
 }
 
-void FlowField::createFlowArrows(sf::RenderWindow& window, int x, int y, sf::Vector2i direction) const
+void FlowField::updateIntegrationCost(int x, int y)
 {
-    if (direction.x == 0 && direction.y == 0)
-        return;
+    Tile& tile = tileAt(x, y);
 
-    sf::Vector2f start = getTileCenter(x, y);
-    sf::Vector2f end = start + sf::Vector2f(direction.x, direction.y) * (tileSize / 2.5f);
-
-    // Draw main arrow line
-    sf::VertexArray arrow(sf::PrimitiveType::Lines, 2);
-    arrow[0].position = start;
-    arrow[0].color = sf::Color::White;
-    arrow[1].position = end;
-    arrow[1].color = sf::Color::White;
-    window.draw(arrow);
+    // Skip unreachable tiles and obstacles
+    if (tile.cost == -1 || tile.terrainCost == 255)
+    {
+        tile.integrationCost = -1;
+        tile.flowDirection = { 0, 0 };
+        return;
+    }
 
-    // Calculate and draw arrowhead
-    sf::Vector2f arrowDir = normalizeVector(end - start);
-    sf::Vector2f perpendicular(-arrowDir.y, arrowDir.x);
+    tile.integrationCost = getIntegrationCost(tile.cost, x - goalPosition.x, y - goalPosition.y);
+}
 
-    float headLength = tileSize / 6.0f;
-    float headWidth = tileSize / 8.0f;
+int FlowField::getIntegrationCost(int cost, int dx, int dy) const
+{
+    if (integrationMode == IntegrationMode::FIXED_OCTILE)
+        return FixedOctileMetric::getIntegrationCost(cost, dx, dy, tileSize);
 
-    sf::Vector2f headPoint1 = end - arrowDir * headLength + perpendicular * headWidth;
-    sf::Vector2f headPoint2 = end - arrowDir * headLength - perpendicular * headWidth;
+    return EuclideanMetric::getIntegrationCost(cost, dx, dy, tileSize);
+}
 
-    sf::VertexArray head1(sf::PrimitiveType::Lines, 2);
-    head1[0].position = end;
-    head1[0].color = sf::Color::White;
-    head1[1].position = headPoint1;
-    head1[1].color = sf::Color::White;
-    window.draw(head1);
+void FlowField::createWeightedCostField()
+{
+    std::fill(costParent.begin(), costParent.end(), -1);
 
-    sf::VertexArray head2(sf::PrimitiveType::Lines, 2);
-    head2[0].position = end;
-    head2[0].color = sf::Color::White;
-    head2[1].position = headPoint2;
-    head2[1].color = sf::Color::White;
-    window.draw(head2);
+    CostQueue openTiles;
+    openTiles.push({ 0, tileIndex(goalPosition.x, goalPosition.y) });
+    relaxCostField(openTiles, nullptr);
 }
 
-void FlowField::setGoal(sf::Vector2f worldPos)
+void FlowField::relaxCostField(CostQueue& openTiles, std::vector<int>* touchedTiles)
 {
-    if (mouseIsInUI(worldPos))
-        return;
-    
-    sf::Vector2i gridPos = worldToGrid(worldPos);
-    
-    if (!isValid(gridPos.x, gridPos.y))
-        return;
-    
-    if (tileIsObstacle(gridPos.x, gridPos.y))
-        return;
-    
-    if (gridPos != startPosition)
+    if (connectivity == Connectivity::FOUR)
     {
-        goalPosition = gridPos;
-        createCostField();
-        createIntegrationField();
-        calculateShortestPath();
+        relaxCostField<FourConnected>(openTiles, touchedTiles);
+    }
+    else
+    {
+        relaxCostField<EightConnected>(openTiles, touchedTiles);
     }
 }
 
-void FlowField::setStart(sf::Vector2f worldPos)
+template <typename Neighbourhood>
+void FlowField::relaxCostField(CostQueue& openTiles, std::vector<int>* touchedTiles)
 {
-    if (mouseIsInUI(worldPos))
-        return;
+    while (!openTiles.empty())
+    {
+        auto [currentCost, current] = openTiles.top();
+        openTiles.pop();
 
-    sf::Vector2i gridPos = worldToGrid(worldPos);
+        // Skip stale queue entries that were improved after being pushed
+        if (grid[current].cost != currentCost)
+            continue;
 
-    if (!isValid(gridPos.x, gridPos.y))
-        return;
+        stats.counters.tilesVisited++;
 
-    if (tileIsObstacle(gridPos.x, gridPos.y))
+        for (int i = 0; i < Neighbourhood::COUNT; i++)
+        {
+            int neighbour = current + neighbourOffset[i];
+
+            if (!tileIsPassable(neighbour))
+                continue;
+
+            if constexpr (Neighbourhood::HAS_DIAGONALS)
+            {
+                if (isDiagonalBlocked(current, i))
+                    continue;
+            }
+
+            int newCost = currentCost + stepCost(neighbour);
+
+            if (grid[neighbour].cost == -1 || newCost < grid[neighbour].cost)
+            {
+                grid[neighbour].cost = newCost;
+                costParent[neighbour] = current;
+                maxCostValue = std::max(maxCostValue, newCost);
+                openTiles.push({ newCost, neighbour });
+                stats.counters.queuePushes++;
+
+                if (touchedTiles)
+                {
+                    touchedTiles->push_back(neighbour);
+                }
+            }
+        }
+    }
+}
+
+void FlowField::repairCostField(const std::vector<int>& raisedTiles, const std::vector<int>& loweredTiles)
+{
+    int goalIndex = tileIndex(goalPosition.x, goalPosition.y);
+
+    // Tiles that got more expensive invalidate every tile whose path was relaxed through them
+    std::vector<int> invalidTiles;
+    for (int index : raisedTiles)
+    {
+        if (index != goalIndex && grid[index].cost != -1)
+        {
+            grid[index].cost = -1;
+            invalidTiles.push_back(index);
+        }
+    }
+
+    for (size_t i = 0; i < invalidTiles.size(); i++)
+    {
+        for (int n = 0; n < NEIGHBOUR_COUNT; n++)
+        {
+            int child = invalidTiles[i] + neighbourOffset[n];
+
+            if (costParent[child] == invalidTiles[i] && grid[child].cost != -1)
+            {
+                grid[child].cost = -1;
+                invalidTiles.push_back(child);
+            }
+        }
+    }
+
+    // Re-seed the wavefront from the still valid tiles bordering invalidated or cheaper tiles
+    CostQueue openTiles;
+    auto seedNeighbours = [&](int index)
+    {
+        for (int n = 0; n < NEIGHBOUR_COUNT; n++)
+        {
+            int neighbour = index + neighbourOffset[n];
+
+            if (grid[neighbour].cost != -1)
+            {
+                openTiles.push({ grid[neighbour].cost, neighbour });
+            }
+        }
+    };
+
+    for (int index : invalidTiles)
+        seedNeighbours(index);
+    for (int index : loweredTiles)
+        seedNeighbours(index);
+
+    std::vector<int> touchedTiles = invalidTiles;
+    relaxCostField(openTiles, &touchedTiles);
+    updateIntegrationTiles(touchedTiles);
+}
+
+void FlowField::updateIntegrationTiles(const std::vector<int>& touchedTiles)
+{
+    // Only tiles whose cost changed, and their neighbours, need new integration values and directions.
+    // Line of sight only depends on which tiles are reachable, so it is only redone from the nearest
+    // ring to the goal where a tile became reachable or unreachable. Cost repairs change neither.
+    int firstChangedRing = -1;
+
+    for (int index : touchedTiles)
+    {
+        int x = indexToX(index);
+        int y = indexToY(index);
+        bool wasReachable = grid[index].integrationCost >= 0;
+        updateIntegrationCost(x, y);
+
+        if (wasReachable != (grid[index].integrationCost >= 0))
+        {
+            int ring = std::max(std::abs(x - goalPosition.x), std::abs(y - goalPosition.y));
+            firstChangedRing = firstChangedRing < 0 ? ring : std::min(firstChangedRing, ring);
+        }
+    }
+
+    for (int index : touchedTiles)
+    {
+        for (int n = -1; n < NEIGHBOUR_COUNT; n++)
+        {
+            int tile = n < 0 ? index : index + neighbourOffset[n];
+
+            if (grid[tile].integrationCost >= 0)
+            {
+                grid[tile].flowDirection = getFlowDirection(tile);
+            }
+        }
+    }
+
+    if (useLineOfSight && firstChangedRing == 0)
+    {
+        createLineOfSight();
+    }
+    else if (useLineOfSight && firstChangedRing > 0)
+    {
+        updateLineOfSight(firstChangedRing);
+    }
+}
+
+void FlowField::createLineOfSight()
+{
+    std::fill(lineOfSight.begin(), lineOfSight.end(), 0);
+
+    if (!useLineOfSight || !isValid(goalPosition.x, goalPosition.y))
+        return;
+
+    int goalIndex = tileIndex(goalPosition.x, goalPosition.y);
+    if (grid[goalIndex].cost != 0)
+        return;
+
+    lineOfSight[goalIndex] = 1;
+    updateLineOfSight(1);
+}
+
+void FlowField::updateLineOfSight(int firstRing)
+{
+    // The line from a tile to the goal crosses the next ring in (by Chebyshev distance) between a
+    // straight and a diagonal neighbour. When both of those see the goal, nothing blocks the narrow
+    // wedge between their lines either, so rings are filled from the goal outwards in one pass.
+    // Tiles with no cost count as walls, which also keeps larger units off tiles they do not fit.
+    auto canSee = [this](int x, int y)
+    {
+        int index = tileIndex(x, y);
+        if (grid[index].cost < 0)
+            return false;
+
+        int dx = goalPosition.x - x;
+        int dy = goalPosition.y - y;
+        int stepX = (dx > 0) - (dx < 0);
+        int stepY = (dy > 0) - (dy < 0);
+
+        // Exactly diagonal lines pass through a corner, so both tiles beside it have to be open
+        if (std::abs(dx) == std::abs(dy))
+        {
+            return lineOfSight[index + stepY * stride + stepX] && grid[index + stepX].cost >= 0 &&
+                   grid[index + stepY * stride].cost >= 0;
+        }
+
+        bool alongX = std::abs(dx) > std::abs(dy);
+        int straight = alongX ? index + stepX : index + stepY * stride;
+        int diagonal = alongX ? straight + stepY * stride : straight + stepX;
+
+        return lineOfSight[straight] && lineOfSight[diagonal];
+    };
+
+    int maxRing = std::max({ goalPosition.x, gridWidth - 1 - goalPosition.x,
+                             goalPosition.y, gridHeight - 1 - goalPosition.y });
+
+    // A ring only reads line of sight from the ring inside it, so rings from firstRing out can be
+    // redone on their own
+    for (int ring = firstRing; ring <= maxRing; ring++)
+    {
+        int minX = std::max(0, goalPosition.x - ring);
+        int maxX = std::min(gridWidth - 1, goalPosition.x + ring);
+        int minY = std::max(0, goalPosition.y - ring);
+        int maxY = std::min(gridHeight - 1, goalPosition.y + ring);
+
+        for (int y = minY; y <= maxY; y++)
+        {
+            // Top and bottom rows of the ring are full, the rows between only have their two ends
+            bool fullRow = std::abs(y - goalPosition.y) == ring;
+            int xStep = fullRow ? 1 : 2 * ring;
+
+            for (int x = fullRow ? minX : goalPosition.x - ring; x <= maxX; x += xStep)
+            {
+                if (x >= 0)
+                {
+                    lineOfSight[tileIndex(x, y)] = canSee(x, y);
+                }
+            }
+        }
+    }
+}
+
+bool FlowField::setGoalTileBounded(sf::Vector2i gridPos, const std::vector<sf::Vector2i>& agentTiles, int margin)
+{
+    if (!isValid(gridPos.x, gridPos.y))
+        return false;
+
+    if (tileIsObstacle(gridPos.x, gridPos.y))
+        return false;
+
+    if (gridPos == startPosition)
+        return false;
+
+    goalPosition = gridPos;
+    createBoundedCostField(agentTiles, margin);
+    calculateShortestPath();
+    return true;
+}
+
+void FlowField::createBoundedCostField(const std::vector<sf::Vector2i>& agentTiles, int margin)
+{
+    std::vector<int> touchedTiles;
+    {
+        ScopedStageTimer timer(stats, FlowFieldStats::Stage::COST_FIELD);
+        stats.counters.tilesVisited = 0;
+        stats.counters.queuePushes = 0;
+
+        // A previous bounded field only touched its expanded tiles, anything else needs a full clear
+        if (costFieldBounded)
+        {
+            for (int index : expandedTiles)
+            {
+                grid[index].cost = -1;
+                grid[index].integrationCost = -1;
+                grid[index].flowDirection = { 0, 0 };
+            }
+        }
+        else
+        {
+            for (Tile& tile : grid)
+            {
+                tile.cost = -1;
+                tile.integrationCost = -1;
+                tile.flowDirection = { 0, 0 };
+            }
+        }
+
+        costFieldBounded = true;
+        boundedMargin = std::max(0, margin);
+        coveredCost = -1;
+        maxCostValue = 0;
+        expandedTiles.clear();
+        costFrontier = CostQueue();
+
+        if (!isValid(goalPosition.x, goalPosition.y) ||
+            !tileIsPassable(goalPosition.x, goalPosition.y))
+        {
+            return;
+        }
+
+        int goalIndex = tileIndex(goalPosition.x, goalPosition.y);
+        grid[goalIndex].cost = 0;
+        costParent[goalIndex] = -1;
+        expandedTiles.push_back(goalIndex);
+        costFrontier.push({ 0, goalIndex });
+        stats.counters.queuePushes++;
+        touchedTiles.push_back(goalIndex);
+
+        // The start tile always needs a path, so it counts as one more agent
+        std::vector<sf::Vector2i> coveredTiles = agentTiles;
+        coveredTiles.push_back(startPosition);
+        expandBoundedField(coveredTiles, touchedTiles);
+    }
+
+    ScopedStageTimer timer(stats, FlowFieldStats::Stage::INTEGRATION_FIELD);
+    updateIntegrationTiles(touchedTiles);
+}
+
+void FlowField::expandCostField(const std::vector<sf::Vector2i>& agentTiles)
+{
+    if (!costFieldBounded)
+        return;
+
+    std::vector<int> touchedTiles;
+    {
+        ScopedStageTimer timer(stats, FlowFieldStats::Stage::COST_FIELD);
+        stats.counters.tilesVisited = 0;
+        stats.counters.queuePushes = 0;
+        expandBoundedField(agentTiles, touchedTiles);
+    }
+
+    ScopedStageTimer timer(stats, FlowFieldStats::Stage::INTEGRATION_FIELD);
+    updateIntegrationTiles(touchedTiles);
+}
+
+void FlowField::expandBoundedField(const std::vector<sf::Vector2i>& agentTiles, std::vector<int>& touchedTiles)
+{
+    // Agents that can reach the goal but are not yet covered with enough margin
+    std::unordered_set<int> pendingAgents;
+    for (sf::Vector2i agent : agentTiles)
+    {
+        if (!isValid(agent.x, agent.y) || !isReachable(agent, goalPosition))
+            continue;
+
+        int index = tileIndex(agent.x, agent.y);
+        if (grid[index].cost != -1 && grid[index].cost + boundedMargin <= coveredCost)
+            continue;
+
+        pendingAgents.insert(index);
+    }
+
+    if (pendingAgents.empty())
+        return;
+
+    // Same wavefront as the full field, but the queue is kept so expansion can pick up where it stopped.
+    // Tiles come off the queue in cost order, so everything popped so far is final.
+    int costLimit = coveredCost;
+    int neighbourCount = getNeighbourCount();
+
+    while (!costFrontier.empty())
+    {
+        auto [currentCost, current] = costFrontier.top();
+
+        if (pendingAgents.empty() && currentCost > costLimit)
+            break;
+
+        costFrontier.pop();
+
+        // Skip stale queue entries that were improved after being pushed
+        if (grid[current].cost != currentCost)
+            continue;
+
+        stats.counters.tilesVisited++;
+
+        if (pendingAgents.erase(current) > 0)
+        {
+            costLimit = std::max(costLimit, currentCost + boundedMargin);
+        }
+
+        for (int i = 0; i < neighbourCount; i++)
+        {
+            int neighbour = current + neighbourOffset[i];
+
+            if (!tileIsPassable(neighbour))
+                continue;
+
+            if (isDiagonalBlocked(current, i))
+                continue;
+
+            int newCost = currentCost + (hasStepCosts() ? stepCost(neighbour) : 1);
+
+            if (grid[neighbour].cost == -1 || newCost < grid[neighbour].cost)
+            {
+                if (grid[neighbour].cost == -1)
+                {
+                    expandedTiles.push_back(neighbour);
+                }
+
+                grid[neighbour].cost = newCost;
+                costParent[neighbour] = current;
+                maxCostValue = std::max(maxCostValue, newCost);
+                costFrontier.push({ newCost, neighbour });
+                stats.counters.queuePushes++;
+                touchedTiles.push_back(neighbour);
+            }
+        }
+    }
+
+    coveredCost = costLimit;
+}
+
+bool FlowField::isCostFieldBounded() const
+{
+    return costFieldBounded;
+}
+
+std::uint64_t FlowField::getTerrainHash() const
+{
+    if (!terrainHashDirty)
+        return terrainHash;
+
+    // FNV-1a over the grid size and every terrain cost
+    const std::uint64_t FNV_OFFSET = 14695981039346656037ull;
+    const std::uint64_t FNV_PRIME = 1099511628211ull;
+
+    auto hashValue = [&](std::uint64_t& hash, std::uint32_t value)
+    {
+        for (int byte = 0; byte < 4; byte++)
+        {
+            hash ^= (value >> (byte * 8)) & 0xFF;
+            hash *= FNV_PRIME;
+        }
+    };
+
+    std::uint64_t hash = FNV_OFFSET;
+    hashValue(hash, static_cast<std::uint32_t>(gridWidth));
+    hashValue(hash, static_cast<std::uint32_t>(gridHeight));
+
+    for (int y = 0; y < gridHeight; y++)
+    {
+        for (int index = tileIndex(0, y); index <= tileIndex(gridWidth - 1, y); index++)
+        {
+            hashValue(hash, static_cast<std::uint32_t>(grid[index].terrainCost));
+        }
+    }
+
+    terrainHash = hash;
+    terrainHashDirty = false;
+    return terrainHash;
+}
+
+void FlowField::exportField(std::vector<std::int32_t>& costs, std::vector<std::int32_t>& integrationCosts,
+                            std::vector<std::int8_t>& directions) const
+{
+    costs.clear();
+    integrationCosts.clear();
+    directions.clear();
+
+    for (int y = 0; y < gridHeight; y++)
+    {
+        for (int index = tileIndex(0, y); index <= tileIndex(gridWidth - 1, y); index++)
+        {
+            sf::Vector2i direction = grid[index].flowDirection;
+            costs.push_back(grid[index].cost);
+            integrationCosts.push_back(grid[index].integrationCost);
+            directions.push_back(static_cast<std::int8_t>((direction.y + 1) * 3 + direction.x + 1));
+        }
+    }
+}
+
+bool FlowField::importField(sf::Vector2i goal, const std::int32_t* costs, const std::int32_t* integrationCosts,
+                            const std::int8_t* directions)
+{
+    if (!isValid(goal.x, goal.y) || tileIsObstacle(goal.x, goal.y) || goal == startPosition)
+        return false;
+
+    goalPosition = goal;
+    costFieldBounded = false;
+    expandedTiles.clear();
+    costFrontier = CostQueue();
+    maxCostValue = 0;
+
+    for (int y = 0; y < gridHeight; y++)
+    {
+        for (int x = 0; x < gridWidth; x++)
+        {
+            int source = y * gridWidth + x;
+            Tile& tile = tileAt(x, y);
+
+            tile.cost = costs[source];
+            tile.integrationCost = integrationCosts[source];
+            tile.flowDirection = sf::Vector2i(directions[source] % 3 - 1, directions[source] / 3 - 1);
+            maxCostValue = std::max(maxCostValue, tile.cost);
+        }
+    }
+
+    createLineOfSight();
+    calculateShortestPath();
+    return true;
+}
+
+MultiGoalFields FlowField::createMultiGoalFields(const std::vector<sf::Vector2i>& goals) const
+{
+    ScopedStageTimer timer(stats, FlowFieldStats::Stage::MULTI_GOAL);
+
+    MultiGoalFields fields;
+    fields.stride = stride;
+    fields.goalCount = static_cast<int>(goals.size());
+    fields.costs.assign(grid.size() * goals.size(), -1);
+    fields.integrationCosts.assign(grid.size() * goals.size(), -1);
+    fields.directions.assign(grid.size() * goals.size(), 4);
+
+    // Terrain, clearance and diagonal checks are the same for every goal, so do them once up front
+    std::vector<std::uint8_t> moveMasks = createMoveMasks();
+
+    // Each sweep carries up to one goal per bit of the lane mask
+    for (int firstGoal = 0; firstGoal < fields.goalCount; firstGoal += MULTI_GOAL_LANES)
+    {
+        sweepMultiGoalCosts(goals, firstGoal, std::min(MULTI_GOAL_LANES, fields.goalCount - firstGoal),
+                            moveMasks, fields);
+    }
+
+    // Integration and directions follow the single goal rules exactly, one goal after the other per tile
+    int goalCount = fields.goalCount;
+    std::vector<int> bestCost(goalCount);
+    std::vector<int> bestEuclidean(goalCount);
+
+    for (int y = 0; y < gridHeight; y++)
+    {
+        for (int x = 0; x < gridWidth; x++)
+        {
+            int index = tileIndex(x, y);
+            const int* costs = &fields.costs[index * goalCount];
+            std::int32_t* integrationCosts = &fields.integrationCosts[index * goalCount];
+
+            for (int goal = 0; goal < goalCount; goal++)
+            {
+                if (costs[goal] == -1)
+                    continue;
+
+                integrationCosts[goal] = getIntegrationCost(costs[goal], x - goals[goal].x, y - goals[goal].y);
+            }
+        }
+    }
+
+    for (int y = 0; y < gridHeight; y++)
+    {
+        for (int x = 0; x < gridWidth; x++)
+        {
+            int index = tileIndex(x, y);
+            const int* costs = &fields.costs[index * goalCount];
+            std::int8_t* directions = &fields.directions[index * goalCount];
+
+            std::fill(bestCost.begin(), bestCost.end(), std::numeric_limits<int>::max());
+            std::fill(bestEuclidean.begin(), bestEuclidean.end(), std::numeric_limits<int>::max());
+
+            // Terrain and diagonal checks are done once per neighbour and shared by all goals
+            for (int i = 0; i < getNeighbourCount(); i++)
+            {
+                int neighbour = index + neighbourOffset[i];
+
+                if (grid[neighbour].terrainCost == 255 || isDiagonalBlocked(index, i))
+                    continue;
+
+                const int* neighbourCosts = &fields.costs[neighbour * goalCount];
+                const std::int32_t* neighbourIntegration = &fields.integrationCosts[neighbour * goalCount];
+
+                for (int goal = 0; goal < goalCount; goal++)
+                {
+                    // Only step downhill, unreachable tiles and goals themselves have no direction
+                    if (neighbourIntegration[goal] < 0 || costs[goal] <= 0 || neighbourCosts[goal] >= costs[goal])
+                        continue;
+
+                    int dx = x + DX[i] - goals[goal].x;
+                    int dy = y + DY[i] - goals[goal].y;
+                    int euclideanDist = dx * dx + dy * dy;
+
+                    if (neighbourIntegration[goal] < bestCost[goal] ||
+                        (neighbourIntegration[goal] == bestCost[goal] && euclideanDist < bestEuclidean[goal]))
+                    {
+                        bestCost[goal] = neighbourIntegration[goal];
+                        bestEuclidean[goal] = euclideanDist;
+                        directions[goal] = static_cast<std::int8_t>((DY[i] + 1) * 3 + DX[i] + 1);
+                    }
+                }
+            }
+        }
+    }
+
+    return fields;
+}
+
+int FlowField::lowestLane(LaneMask lanes)
+{
+#ifdef _MSC_VER
+    unsigned long lane;
+    _BitScanForward64(&lane, lanes);
+    return static_cast<int>(lane);
+#else
+    return __builtin_ctzll(lanes);
+#endif
+}
+
+std::vector<std::uint8_t> FlowField::createMoveMasks() const
+{
+    // Bit i is set when the wavefront can step from the tile towards neighbour i
+    std::vector<std::uint8_t> moveMasks(grid.size(), 0);
+    int neighbourCount = getNeighbourCount();
+
+    for (int y = 0; y < gridHeight; y++)
+    {
+        for (int index = tileIndex(0, y); index <= tileIndex(gridWidth - 1, y); index++)
+        {
+            for (int i = 0; i < neighbourCount; i++)
+            {
+                if (tileIsPassable(index + neighbourOffset[i]) && !isDiagonalBlocked(index, i))
+                {
+                    moveMasks[index] |= 1 << i;
+                }
+            }
+        }
+    }
+
+    return moveMasks;
+}
+
+void FlowField::sweepMultiGoalCosts(const std::vector<sf::Vector2i>& goals, int firstGoal, int laneCount,
+                                    const std::vector<std::uint8_t>& moveMasks, MultiGoalFields& fields) const
+{
+    // Level synchronous BFS where every tile carries a bit per goal. A neighbour is loaded once per
+    // level for all goals whose wavefronts are passing through, instead of once per goal.
+    std::vector<LaneMask> visited(grid.size(), 0);
+    std::vector<LaneMask> frontierMask(grid.size(), 0);
+    std::vector<LaneMask> nextMask(grid.size(), 0);
+    std::vector<int> frontier;
+    std::vector<int> next;
+
+    for (int lane = 0; lane < laneCount; lane++)
+    {
+        sf::Vector2i goal = goals[firstGoal + lane];
+        if (!isValid(goal.x, goal.y) || !tileIsPassable(goal.x, goal.y))
+            continue;
+
+        int index = tileIndex(goal.x, goal.y);
+        if (frontierMask[index] == 0)
+        {
+            frontier.push_back(index);
+        }
+
+        LaneMask bit = LaneMask(1) << lane;
+        visited[index] |= bit;
+        frontierMask[index] |= bit;
+        fields.costs[index * fields.goalCount + firstGoal + lane] = 0;
+    }
+
+    for (int level = 1; !frontier.empty(); level++)
+    {
+        for (int current : frontier)
+        {
+            LaneMask lanes = frontierMask[current];
+            frontierMask[current] = 0;
+            int moves = moveMasks[current];
+
+            for (int i = 0; i < NEIGHBOUR_COUNT; i++)
+            {
+                if ((moves & (1 << i)) == 0)
+                    continue;
+
+                int neighbour = current + neighbourOffset[i];
+
+                LaneMask reached = lanes & ~visited[neighbour];
+                if (reached == 0)
+                    continue;
+
+                if (nextMask[neighbour] == 0)
+                {
+                    next.push_back(neighbour);
+                }
+                visited[neighbour] |= reached;
+                nextMask[neighbour] |= reached;
+            }
+        }
+
+        for (int index : next)
+        {
+            LaneMask lanes = nextMask[index];
+            nextMask[index] = 0;
+            frontierMask[index] = lanes;
+
+            int* costs = &fields.costs[index * fields.goalCount + firstGoal];
+            while (lanes != 0)
+            {
+                costs[lowestLane(lanes)] = level;
+                lanes &= lanes - 1;
+            }
+        }
+
+        frontier.swap(next);
+        next.clear();
+    }
+}
+
+int MultiGoalFields::valueIndex(int x, int y, int goal) const
+{
+    return ((y + 1) * stride + x + 1) * goalCount + goal;
+}
+
+int MultiGoalFields::getCost(int x, int y, int goal) const
+{
+    return costs[valueIndex(x, y, goal)];
+}
+
+int MultiGoalFields::getIntegrationCost(int x, int y, int goal) const
+{
+    return integrationCosts[valueIndex(x, y, goal)];
+}
+
+sf::Vector2i MultiGoalFields::getFlowDirection(int x, int y, int goal) const
+{
+    int direction = directions[valueIndex(x, y, goal)];
+    return sf::Vector2i(direction % 3 - 1, direction / 3 - 1);
+}
+
+std::vector<sf::Vector2i> PathTree::getPath(int start) const
+{
+    std::vector<sf::Vector2i> path;
+
+    int node = entries[start];
+    if (node >= 0)
+    {
+        path.reserve(nodes[node].length + 1);
+    }
+
+    for (; node >= 0; node = nodes[node].next)
+    {
+        path.push_back(nodes[node].tile);
+    }
+    return path;
+}
+
+void FlowField::setUnitSize(int size)
+{
+    size = std::max(1, std::min(MAX_UNIT_SIZE, size));
+    if (size == unitSize)
+        return;
+
+    unitSize = size;
+    minClearance = clearanceForSize(unitSize);
+
+    npc.setRadius(tileSize * unitSize / 2.0f - tileSize / 6.0f);
+    npc.setOrigin(sf::Vector2f(npc.getRadius(), npc.getRadius()));
+
+    // Terrain and clearance are shared, only the field itself is rebuilt for the new size class
+    if (isValid(goalPosition.x, goalPosition.y))
+    {
+        createCostField();
+        createIntegrationField();
+        calculateShortestPath();
+    }
+}
+
+void FlowField::cycleUnitSize()
+{
+    setUnitSize(unitSize % MAX_UNIT_SIZE + 1);
+}
+
+int FlowField::getUnitSize() const
+{
+    return unitSize;
+}
+
+int FlowField::getClearance(int x, int y) const
+{
+    return isValid(x, y) ? clearance[tileIndex(x, y)] : 0;
+}
+
+int FlowField::clearanceForSize(int size)
+{
+    // An odd sized unit overlaps size / 2 rings around its tile. An even sized one overlaps
+    // size / 2 - 1 rings around each of the four tiles sharing its corner, see tileIsPassable.
+    return (size + 1) / 2;
+}
+
+bool FlowField::isDynamicCostEnabled() const
+{
+    return useDynamicCost;
+}
+
+void FlowField::setDynamicCostEnabled(bool enabled)
+{
+    if (useDynamicCost == enabled)
+        return;
+
+    useDynamicCost = enabled;
+
+    if (!useDynamicCost)
+    {
+        std::fill(densityField.begin(), densityField.end(), 0.0f);
+        std::fill(dynamicCost.begin(), dynamicCost.end(), 0);
+    }
+
+    if (isValid(goalPosition.x, goalPosition.y))
+    {
+        createCostField();
+        createIntegrationField();
+        calculateShortestPath();
+    }
+}
+
+void FlowField::setIntegrationMode(IntegrationMode mode)
+{
+    if (integrationMode == mode)
+        return;
+
+    integrationMode = mode;
+
+    // The cost field does not depend on the mode, only integration and directions are redone
+    if (isValid(goalPosition.x, goalPosition.y))
+    {
+        createIntegrationField();
+        calculateShortestPath();
+    }
+}
+
+void FlowField::toggleIntegrationMode()
+{
+    setIntegrationMode(integrationMode == IntegrationMode::EUCLIDEAN ? IntegrationMode::FIXED_OCTILE
+                                                                     : IntegrationMode::EUCLIDEAN);
+}
+
+FlowField::IntegrationMode FlowField::getIntegrationMode() const
+{
+    return integrationMode;
+}
+
+void FlowField::setConnectivity(Connectivity newConnectivity)
+{
+    if (connectivity == newConnectivity)
+        return;
+
+    connectivity = newConnectivity;
+
+    // Regions are the same either way, diagonals never connect tiles that straight moves cannot
+    if (isValid(goalPosition.x, goalPosition.y))
+    {
+        createCostField();
+        createIntegrationField();
+        calculateShortestPath();
+    }
+}
+
+void FlowField::toggleConnectivity()
+{
+    setConnectivity(connectivity == Connectivity::EIGHT ? Connectivity::FOUR : Connectivity::EIGHT);
+}
+
+FlowField::Connectivity FlowField::getConnectivity() const
+{
+    return connectivity;
+}
+
+void FlowField::setLineOfSightEnabled(bool enabled)
+{
+    if (useLineOfSight == enabled)
+        return;
+
+    useLineOfSight = enabled;
+
+    // Directions on the grid are untouched, only the straight line overrides change
+    createLineOfSight();
+}
+
+void FlowField::toggleLineOfSight()
+{
+    setLineOfSightEnabled(!useLineOfSight);
+}
+
+bool FlowField::isLineOfSightEnabled() const
+{
+    return useLineOfSight;
+}
+
+bool FlowField::hasLineOfSight(int x, int y) const
+{
+    return isValid(x, y) && lineOfSight[tileIndex(x, y)] != 0;
+}
+
+int FlowField::getNeighbourCount() const
+{
+    return connectivity == Connectivity::FOUR ? FourConnected::COUNT : EightConnected::COUNT;
+}
+
+void FlowField::updateDynamicCost(const std::vector<sf::Vector2f>& agentPositions,
+                                  const std::vector<sf::Vector2f>& agentVelocities)
+{
+    if (!useDynamicCost)
+        return;
+
+    ScopedStageTimer timer(stats, FlowFieldStats::Stage::DYNAMIC_COST);
+    splatAgentDensity(agentPositions, agentVelocities);
+
+    // Convert density to whole cost steps and keep track of which tiles moved
+    std::vector<int> raisedTiles;
+    std::vector<int> loweredTiles;
+
+    for (int i = 0; i < static_cast<int>(densityField.size()); i++)
+    {
+        float discomfort = std::max(0.0f, densityField[i] - DENSITY_COMFORT);
+        int newCost = std::min(MAX_DYNAMIC_COST, static_cast<int>(discomfort * DENSITY_COST_WEIGHT));
+
+        if (newCost > dynamicCost[i])
+            raisedTiles.push_back(i);
+        else if (newCost < dynamicCost[i])
+            loweredTiles.push_back(i);
+
+        dynamicCost[i] = newCost;
+    }
+
+    if (raisedTiles.empty() && loweredTiles.empty())
+        return;
+
+    stats.counters.tilesVisited = 0;
+    stats.counters.queuePushes = 0;
+
+    if (!isValid(goalPosition.x, goalPosition.y) || tileIsObstacle(goalPosition.x, goalPosition.y))
+        return;
+
+    // A bounded field has no complete parent tree to repair, so it is rebuilt around this tick's agents
+    if (costFieldBounded)
+    {
+        std::vector<sf::Vector2i> agentTiles;
+        agentTiles.reserve(agentPositions.size());
+        for (sf::Vector2f position : agentPositions)
+        {
+            agentTiles.push_back(worldToGrid(position));
+        }
+        createBoundedCostField(agentTiles, boundedMargin);
+    }
+    else
+    {
+        repairCostField(raisedTiles, loweredTiles);
+    }
+    calculateShortestPath();
+}
+
+void FlowField::setSoftCostRows(int firstRow, int rowCount, const std::uint8_t* costs)
+{
+    // Rows outside the grid are dropped, the source skipping along with any cut off above row 0
+    int skippedRows = std::max(0, -firstRow);
+    firstRow += skippedRows;
+    rowCount = std::min(rowCount - skippedRows, gridHeight - firstRow);
+
+    if (rowCount <= 0)
+        return;
+    costs += static_cast<size_t>(skippedRows) * gridWidth;
+
+    // Only a field built with Dijkstra has the parent tree repairs need
+    bool repairable = hasStepCosts() && !costFieldBounded;
+
+    std::vector<int> raisedTiles;
+    std::vector<int> loweredTiles;
+
+    for (int y = firstRow; y < firstRow + rowCount; y++)
+    {
+        const std::uint8_t* row = costs + (y - firstRow) * gridWidth;
+        for (int x = 0; x < gridWidth; x++)
+        {
+            int index = tileIndex(x, y);
+            if (row[x] == softCost[index])
+                continue;
+
+            if (row[x] > softCost[index])
+                raisedTiles.push_back(index);
+            else
+                loweredTiles.push_back(index);
+
+            softCostTiles += (row[x] > 0) - (softCost[index] > 0);
+            softCost[index] = row[x];
+        }
+    }
+
+    if ((raisedTiles.empty() && loweredTiles.empty()) || !isValid(goalPosition.x, goalPosition.y) ||
+        tileIsObstacle(goalPosition.x, goalPosition.y))
+    {
+        return;
+    }
+
+    stats.counters.tilesVisited = 0;
+    stats.counters.queuePushes = 0;
+
+    if (repairable)
+    {
+        repairCostField(raisedTiles, loweredTiles);
+    }
+    else
+    {
+        createCostField();
+        createIntegrationField();
+    }
+    calculateShortestPath();
+}
+
+void FlowField::splatAgentDensity(const std::vector<sf::Vector2f>& agentPositions,
+                                  const std::vector<sf::Vector2f>& agentVelocities)
+{
+    std::fill(densityField.begin(), densityField.end(), 0.0f);
+
+    int agentCount = static_cast<int>(agentPositions.size());
+    int workerCount = 1;
+
+    if (agentCount >= PARALLEL_SPLAT_THRESHOLD)
+    {
+        workerCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        workerCount = std::min(workerCount, agentCount / PARALLEL_SPLAT_THRESHOLD + 1);
+    }
+
+    // Each worker splats its own slice of agents into a private buffer, the first one writes in place
+    std::vector<std::vector<float>> partialDensity(workerCount - 1,
+        std::vector<float>(densityField.size(), 0.0f));
+
+    auto splatRange = [&](std::vector<float>& density, int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            sf::Vector2f velocity = i < static_cast<int>(agentVelocities.size()) ? agentVelocities[i] : sf::Vector2f();
+
+            splatPoint(density, agentPositions[i], 1.0f);
+            splatPoint(density, agentPositions[i] + velocity * DENSITY_LOOKAHEAD, DENSITY_LOOKAHEAD_WEIGHT);
+        }
+    };
+
+    int agentsPerWorker = (agentCount + workerCount - 1) / workerCount;
+    std::vector<std::thread> workers;
+
+    for (int w = 1; w < workerCount; w++)
+    {
+        int begin = std::min(agentCount, w * agentsPerWorker);
+        int end = std::min(agentCount, begin + agentsPerWorker);
+        workers.emplace_back(splatRange, std::ref(partialDensity[w - 1]), begin, end);
+    }
+
+    splatRange(densityField, 0, std::min(agentCount, agentsPerWorker));
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    for (const std::vector<float>& partial : partialDensity)
+    {
+        for (size_t i = 0; i < densityField.size(); i++)
+        {
+            densityField[i] += partial[i];
+        }
+    }
+}
+
+void FlowField::splatPoint(std::vector<float>& density, sf::Vector2f worldPos, float weight) const
+{
+    // Bilinear splat onto the four tile centres surrounding the point
+    float gridX = (worldPos.x - UI_WIDTH) / tileSize - 0.5f;
+    float gridY = worldPos.y / tileSize - 0.5f;
+
+    int x0 = static_cast<int>(std::floor(gridX));
+    int y0 = static_cast<int>(std::floor(gridY));
+    float fx = gridX - x0;
+    float fy = gridY - y0;
+
+    const float weights[4] = { (1.0f - fx) * (1.0f - fy), fx * (1.0f - fy), (1.0f - fx) * fy, fx * fy };
+
+    for (int i = 0; i < 4; i++)
+    {
+        int x = x0 + (i & 1);
+        int y = y0 + (i >> 1);
+
+        if (isValid(x, y))
+        {
+            density[tileIndex(x, y)] += weights[i] * weight;
+        }
+    }
+}
+
+void FlowField::createFlowArrows(sf::VertexArray& lines, int x, int y, sf::Vector2f direction) const
+{
+    if (direction.x == 0.0f && direction.y == 0.0f)
+        return;
+
+    sf::Vector2f start = getTileCenter(x, y);
+    sf::Vector2f end = start + direction * (tileSize / 2.5f);
+
+    // Calculate arrowhead
+    sf::Vector2f arrowDir = normalizeVector(end - start);
+    sf::Vector2f perpendicular(-arrowDir.y, arrowDir.x);
+
+    float headLength = tileSize / 6.0f;
+    float headWidth = tileSize / 8.0f;
+
+    sf::Vector2f headPoint1 = end - arrowDir * headLength + perpendicular * headWidth;
+    sf::Vector2f headPoint2 = end - arrowDir * headLength - perpendicular * headWidth;
+
+    // Main line and both halves of the head, appended so all arrows go out in one draw call
+    lines.append(sf::Vertex{ start, sf::Color::White });
+    lines.append(sf::Vertex{ end, sf::Color::White });
+    lines.append(sf::Vertex{ end, sf::Color::White });
+    lines.append(sf::Vertex{ headPoint1, sf::Color::White });
+    lines.append(sf::Vertex{ end, sf::Color::White });
+    lines.append(sf::Vertex{ headPoint2, sf::Color::White });
+}
+
+void FlowField::setGoal(sf::Vector2f worldPos)
+{
+    setGoalTile(worldToGrid(worldPos));
+}
+
+void FlowField::setStart(sf::Vector2f worldPos)
+{
+    setStartTile(worldToGrid(worldPos));
+}
+
+bool FlowField::setGoalTile(sf::Vector2i gridPos)
+{
+    if (gridPos == startPosition)
+        return false;
+
+    return buildGoalField(gridPos);
+}
+
+bool FlowField::buildGoalField(sf::Vector2i gridPos)
+{
+    if (!isValid(gridPos.x, gridPos.y))
+        return false;
+    
+    if (tileIsObstacle(gridPos.x, gridPos.y))
+        return false;
+
+    goalPosition = gridPos;
+    createCostField();
+    createIntegrationField();
+    calculateShortestPath();
+    return true;
+}
+
+bool FlowField::setStartTile(sf::Vector2i gridPos)
+{
+    if (!isValid(gridPos.x, gridPos.y))
+        return false;
+
+    if (tileIsObstacle(gridPos.x, gridPos.y))
+        return false;
+
+    if (gridPos == goalPosition)
+        return false;
+
+    startPosition = gridPos;
+
+    // A start outside the bounded area pulls the wavefront out to it
+    if (costFieldBounded)
+    {
+        expandCostField({ gridPos });
+    }
+
+	calculateShortestPath();
+    return true;
+}
+
+void FlowField::loadTerrain(const std::vector<std::uint8_t>& terrainCosts)
+{
+    if (static_cast<int>(terrainCosts.size()) != gridWidth * gridHeight)
+        return;
+
+    for (int y = 0; y < gridHeight; y++)
+    {
+        for (int x = 0; x < gridWidth; x++)
+        {
+            tileAt(x, y) = Tile();
+            tileAt(x, y).terrainCost = terrainCosts[y * gridWidth + x];
+        }
+    }
+
+    createClearanceField();
+    createComponents();
+
+    costFieldBounded = false;
+    expandedTiles.clear();
+    costFrontier = CostQueue();
+    fieldTextureDirty = true;
+    terrainHashDirty = true;
+
+    // Old start, goal and path may sit on new obstacles, so start from a clean slate
+    startPosition = { -1, -1 };
+    goalPosition = { -1, -1 };
+    shortestPath.clear();
+    npcActive = false;
+    maxCostValue = 0;
+}
+
+bool FlowField::loadMap(const std::string& path)
+{
+    int width = 0;
+    int height = 0;
+    std::vector<std::uint8_t> terrainCosts;
+
+    if (!MapGenerator::readMap(path, width, height, terrainCosts))
+        return false;
+
+    if (width != gridWidth || height != gridHeight)
+    {
+        resizeGrid(width, height);
+    }
+
+    loadTerrain(terrainCosts);
+    return true;
+}
+
+bool FlowField::saveMap(const std::string& path) const
+{
+    std::vector<std::uint8_t> terrainCosts(gridWidth * gridHeight);
+
+    for (int y = 0; y < gridHeight; y++)
+    {
+        for (int x = 0; x < gridWidth; x++)
+        {
+            terrainCosts[y * gridWidth + x] = static_cast<std::uint8_t>(tileAt(x, y).terrainCost);
+        }
+    }
+
+    return MapGenerator::writeMap(path, gridWidth, gridHeight, terrainCosts);
+}
+
+void FlowField::toggleObstacle(sf::Vector2f worldPos)
+{
+    sf::Vector2i gridPos = worldToGrid(worldPos);
+
+    if (!isValid(gridPos.x, gridPos.y))
+        return;
+    
+    if (gridPos == startPosition || gridPos == goalPosition)
         return;
 
-    if (gridPos != goalPosition)
+    // Toggle obstacle state
+    Tile& tile = tileAt(gridPos.x, gridPos.y);
+    if (tile.terrainCost == 255)
+    {
+        tile.terrainCost = 1; // Make normal tile
+    }
+    else
+    {
+        tile.terrainCost = 255; // Make obstacle
+    }
+
+    updateClearance(gridPos.x, gridPos.y);
+    updateComponents(gridPos.x, gridPos.y);
+    fieldTextureDirty = true;
+    terrainHashDirty = true;
+    
+    if (isValid(startPosition.x, startPosition.y) &&
+        isValid(goalPosition.x, goalPosition.y))
+    {
+        createCostField();
+        createIntegrationField();
+        calculateShortestPath();
+    }
+}
+
+void FlowField::render(sf::RenderWindow& window)
+{
+    ScopedStageTimer timer(stats, FlowFieldStats::Stage::RENDER);
+    stats.counters.drawCalls = 0;
+
+    windowSize = sf::Vector2f(window.getSize());
+    window.setView(getCameraView());
+
+    float tilePixels = tileSize * cameraZoom;
+    sf::IntRect visibleTiles = getVisibleTiles();
+    int firstX = visibleTiles.position.x;
+    int firstY = visibleTiles.position.y;
+    int lastX = firstX + visibleTiles.size.x;
+    int lastY = firstY + visibleTiles.size.y;
+
+    bool zoomedOut = tilePixels < MIN_TILE_PIXELS;
+    if (fieldTextureDirty && (zoomedOut || isFieldViewActive()))
+    {
+        updateFieldTexture();
+    }
+
+    // Field views draw the whole grid as one textured quad whenever the texture has a texel per tile
+    bool textured = zoomedOut || (isFieldViewActive() && fieldTextureScale == 1);
+
+    if (textured)
+    {
+        sf::Sprite field(fieldTexture);
+        field.setPosition(gridToWorld(0, 0));
+        field.setScale(sf::Vector2f(tileSize * fieldTextureScale, tileSize * fieldTextureScale));
+        drawCounted(window, field);
+    }
+
+    if (!zoomedOut)
+    {
+        // Tiles leave a 2 pixel outline gap on a dark background, like the old outlined rectangles
+        bool outlines = tilePixels >= MIN_OUTLINE_TILE_PIXELS;
+        float tileGap = outlines ? 2.0f : 0.0f;
+
+        tileVertices.clear();
+        if (textured)
+        {
+            // Over the texture the gaps become grid lines along the visible tile edges
+            if (outlines)
+            {
+                sf::Vector2f topLeft = gridToWorld(firstX, firstY) - sf::Vector2f(1.0f, 1.0f);
+                for (int x = firstX; x <= lastX; x++)
+                {
+                    appendQuad(tileVertices, sf::Vector2f(topLeft.x + (x - firstX) * tileSize, topLeft.y),
+                        sf::Vector2f(tileGap, visibleTiles.size.y * tileSize), sf::Color(40, 40, 40));
+                }
+                for (int y = firstY; y <= lastY; y++)
+                {
+                    appendQuad(tileVertices, sf::Vector2f(topLeft.x, topLeft.y + (y - firstY) * tileSize),
+                        sf::Vector2f(visibleTiles.size.x * tileSize, tileGap), sf::Color(40, 40, 40));
+                }
+            }
+        }
+        else
+        {
+            if (outlines && visibleTiles.size.x > 0 && visibleTiles.size.y > 0)
+            {
+                appendQuad(tileVertices, gridToWorld(firstX, firstY) - sf::Vector2f(1.0f, 1.0f),
+                    sf::Vector2f(visibleTiles.size) * tileSize, sf::Color(40, 40, 40));
+            }
+
+            for (int y = firstY; y < lastY; y++)
+            {
+                for (int x = firstX; x < lastX; x++)
+                {
+                    appendQuad(tileVertices, gridToWorld(x, y), sf::Vector2f(tileSize - tileGap, tileSize - tileGap),
+                        getTileColor(x, y));
+                }
+            }
+        }
+
+        if (tileVertices.getVertexCount() > 0)
+        {
+            drawCounted(window, tileVertices);
+        }
+
+        // Draw cost/integration values if display mode is active and the labels are readable
+        if (displayMode != DisplayMode::NONE && tilePixels >= MIN_TEXT_TILE_PIXELS)
+        {
+            for (int y = firstY; y < lastY; y++)
+            {
+                for (int x = firstX; x < lastX; x++)
+                {
+                    int displayValue = 0;
+                    std::string displayStr;
+
+                    if (displayMode == DisplayMode::COST_FIELD)
+                    {
+                        displayValue = tileAt(x, y).cost;
+                    }
+                    else if (displayMode == DisplayMode::INTEGRATION_FIELD)
+                    {
+                        displayValue = tileAt(x, y).integrationCost;
+                    }
+
+                    if (tileAt(x, y).terrainCost == 255)
+                    {
+                        displayStr = "X";
+                    }
+                    else if (displayValue == -1)
+                    {
+                        displayStr = "-";
+                    }
+                    else
+                    {
+                        displayStr = std::to_string(displayValue);
+                    }
+
+                    costText.setString(displayStr);
+
+                    // Center the text in the tile
+                    sf::FloatRect textBounds = costText.getLocalBounds();
+                    costText.setOrigin(sf::Vector2f(
+                        textBounds.position.x + textBounds.size.x / 2.0f,
+                        textBounds.position.y + textBounds.size.y / 2.0f));
+                    costText.setPosition(getTileCenter(x, y));
+
+                    drawCounted(window, costText);
+                }
+            }
+        }
+
+        // Draw vector field arrows
+        if (showVectorField && tilePixels >= MIN_ARROW_TILE_PIXELS)
+        {
+            lineVertices.clear();
+            for (int y = firstY; y < lastY; y++)
+            {
+                for (int x = firstX; x < lastX; x++)
+                {
+                    if (tileIsReachable(x, y))
+                    {
+                        // Tiles in sight of the goal point straight at it
+                        int index = tileIndex(x, y);
+                        sf::Vector2f direction = lineOfSight[index] ? unitFlowDirection(index)
+                                                                    : sf::Vector2f(grid[index].flowDirection);
+                        createFlowArrows(lineVertices, x, y, direction);
+                    }
+                }
+            }
+            drawCounted(window, lineVertices);
+        }
+    }
+
+    drawShortestPath(window);
+
+    // Draw NPC
+    if (npcActive)
+    {
+        drawCounted(window, npc);
+    }
+
+    // Draw UI in screen space, the stats panel takes the place of the instructions when shown
+    window.setView(window.getDefaultView());
+    UIBox.setSize(sf::Vector2f(UI_WIDTH, windowSize.y));
+    drawCounted(window, UIBox);
+
+    if (showStats)
+    {
+        statsText.setString(stats.getSummary());
+        drawCounted(window, statsText);
+    }
+    else
     {
-        startPosition = gridPos;
-		calculateShortestPath();
+        drawCounted(window, instructionsText);
     }
 }
 
-void FlowField::toggleObstacle(sf::Vector2f worldPos)
+sf::Color FlowField::getTileColor(int x, int y) const
 {
-    if (mouseIsInUI(worldPos))
-        return;
-
-    sf::Vector2i gridPos = worldToGrid(worldPos);
-
-    if (!isValid(gridPos.x, gridPos.y))
-        return;
-    
-    if (gridPos == startPosition || gridPos == goalPosition)
-        return;
+    const Tile& tile = tileAt(x, y);
 
-    // Toggle obstacle state
-    if (grid[gridPos.y][gridPos.x].terrainCost == 255)
+    if (x == goalPosition.x && y == goalPosition.y)
     {
-        grid[gridPos.y][gridPos.x].terrainCost = 1; // Make normal tile
+        return sf::Color(50, 200, 50); // Green for goal
     }
-    else
+    else if (x == startPosition.x && y == startPosition.y)
     {
-        grid[gridPos.y][gridPos.x].terrainCost = 255; // Make obstacle
+        return sf::Color(50, 50, 200); // Blue for start
     }
-    
-    if (isValid(startPosition.x, startPosition.y) &&
-        isValid(goalPosition.x, goalPosition.y))
+    else if (tile.terrainCost == 255)
     {
-        createCostField();
-        createIntegrationField();
-        calculateShortestPath();
+        return sf::Color(255, 0, 0); // Red for obstacles
     }
-}
-
-void FlowField::render(sf::RenderWindow& window)
-{
-    for (int y = 0; y < gridHeight; y++)
+    else if (isFieldViewActive() && heatmapMax > 0)
     {
-        for (int x = 0; x < gridWidth; x++)
+        int value = displayMode == DisplayMode::INTEGRATION_FIELD ? tile.integrationCost : tile.cost;
+        if (value >= 0)
         {
-            int index = y * gridWidth + x;
+            return heatmapLut[static_cast<long long>(std::min(value, heatmapMax)) * 255 / heatmapMax];
+        }
+    }
 
-            // Determine tile color
-            if (x == goalPosition.x && y == goalPosition.y)
-            {
-                tileShapes[index].setFillColor(sf::Color(50, 200, 50)); // Green for goal
-            }
-            else if (x == startPosition.x && y == startPosition.y)
-            {
-                tileShapes[index].setFillColor(sf::Color(50, 50, 200)); // Blue for start
-            }
-            else if (grid[y][x].terrainCost == 255)
-            {
-                tileShapes[index].setFillColor(sf::Color(255, 0, 0)); // Red for obstacles
-            }
-            else if (showHeatmap && grid[y][x].cost != -1 && maxCostValue > 0)
-            {
-                int cost = grid[y][x].cost;
-                sf::Color color;
+    return sf::Color(10, 10, 10); // Default grey
+}
 
-                if (cost <= maxCostValue * 0.1f)
-                    color = sf::Color(255, 245, 200);
-                else if (cost <= maxCostValue * 0.3f)
-                    color = sf::Color(255, 220, 160);
-                else if (cost <= maxCostValue * 0.5f)
-                    color = sf::Color(255, 190, 120);
-                else if (cost <= maxCostValue * 0.7f)
-                    color = sf::Color(255, 160, 90);
-                else if (cost <= maxCostValue * 0.9f)
-                    color = sf::Color(255, 120, 80);
-                else
-                    color = sf::Color(220, 60, 60);
+void FlowField::appendQuad(sf::VertexArray& vertices, sf::Vector2f position, sf::Vector2f size, sf::Color color) const
+{
+    sf::Vector2f topRight = position + sf::Vector2f(size.x, 0.0f);
+    sf::Vector2f bottomLeft = position + sf::Vector2f(0.0f, size.y);
+    sf::Vector2f bottomRight = position + size;
+
+    vertices.append(sf::Vertex{ position, color });
+    vertices.append(sf::Vertex{ topRight, color });
+    vertices.append(sf::Vertex{ bottomLeft, color });
+    vertices.append(sf::Vertex{ bottomLeft, color });
+    vertices.append(sf::Vertex{ topRight, color });
+    vertices.append(sf::Vertex{ bottomRight, color });
+}
 
-                tileShapes[index].setFillColor(color);
-            }
-            else
-            {
-                tileShapes[index].setFillColor(sf::Color(10, 10, 10)); // Default grey
-            }
+void FlowField::createHeatmapLut()
+{
+    // The old six step heat ramp, blended between its steps
+    const sf::Color STEPS[] = { sf::Color(255, 245, 200), sf::Color(255, 220, 160), sf::Color(255, 190, 120),
+                                sf::Color(255, 160, 90), sf::Color(255, 120, 80), sf::Color(220, 60, 60) };
+    const int LAST_STEP = 5;
 
-            window.draw(tileShapes[index]);
+    for (int level = 0; level < 256; level++)
+    {
+        int scaled = level * LAST_STEP;
+        int step = std::min(scaled / 255, LAST_STEP - 1);
+        int blend = scaled - step * 255;
+
+        const sf::Color& low = STEPS[step];
+        const sf::Color& high = STEPS[step + 1];
+        heatmapLut[level] = sf::Color(
+            static_cast<std::uint8_t>(low.r + (high.r - low.r) * blend / 255),
+            static_cast<std::uint8_t>(low.g + (high.g - low.g) * blend / 255),
+            static_cast<std::uint8_t>(low.b + (high.b - low.b) * blend / 255));
+    }
+}
 
-            // Draw cost/integration values if display mode is active
-            if (displayMode != DisplayMode::NONE)
-            {
-                int displayValue = 0;
-                std::string displayStr;
+bool FlowField::isFieldViewActive() const
+{
+    return showHeatmap || displayMode != DisplayMode::NONE;
+}
 
-                if (displayMode == DisplayMode::COST_FIELD)
-                {
-                    displayValue = grid[y][x].cost;
-                }
-                else if (displayMode == DisplayMode::INTEGRATION_FIELD)
-                {
-                    displayValue = static_cast<int>(grid[y][x].integrationCost);
-                }
+void FlowField::updateFieldTexture()
+{
+    // The colour range follows the field being shown
+    heatmapMax = maxCostValue;
+    if (displayMode == DisplayMode::INTEGRATION_FIELD)
+    {
+        heatmapMax = 0;
+        for (const Tile& tile : grid)
+        {
+            heatmapMax = std::max(heatmapMax, tile.integrationCost);
+        }
+    }
 
-                if (grid[y][x].terrainCost == 255)
-                {
-                    displayStr = "X";
-                }
-                else if (displayValue == -1)
-                {
-                    displayStr = "-";
-                }
-                else
-                {
-                    displayStr = std::to_string(displayValue);
-                }
+    // One texel per tile where it fits, otherwise each texel averages a square block of tiles
+    int largestSide = std::max(gridWidth, gridHeight);
+    fieldTextureScale = (largestSide + MAX_FIELD_TEXTURE_SIZE - 1) / MAX_FIELD_TEXTURE_SIZE;
 
-                costText.setString(displayStr);
+    int textureWidth = (gridWidth + fieldTextureScale - 1) / fieldTextureScale;
+    int textureHeight = (gridHeight + fieldTextureScale - 1) / fieldTextureScale;
+    fieldPixels.assign(textureWidth * textureHeight * 4, 255);
 
-                // Center the text in the tile
-                sf::FloatRect textBounds = costText.getLocalBounds();
-                costText.setOrigin(sf::Vector2f(
-                    textBounds.position.x + textBounds.size.x / 2.0f,
-                    textBounds.position.y + textBounds.size.y / 2.0f));
-                costText.setPosition(getTileCenter(x, y));
+    // Colour sums and tile counts for one row of texels at a time
+    std::vector<int> rowSums(textureWidth * 4);
 
-                window.draw(costText);
-            }
+    for (int texelY = 0; texelY < textureHeight && fieldTextureScale == 1; texelY++)
+    {
+        // Texel per tile, colours go straight into the buffer
+        std::uint8_t* pixel = &fieldPixels[texelY * textureWidth * 4];
+        for (int x = 0; x < gridWidth; x++, pixel += 4)
+        {
+            sf::Color color = getTileColor(x, texelY);
+            pixel[0] = color.r;
+            pixel[1] = color.g;
+            pixel[2] = color.b;
         }
     }
 
-    // Draw vector field arrows
-    if (showVectorField)
+    for (int texelY = 0; texelY < textureHeight && fieldTextureScale > 1; texelY++)
     {
-        for (int y = 0; y < gridHeight; y++)
+        std::fill(rowSums.begin(), rowSums.end(), 0);
+
+        for (int y = texelY * fieldTextureScale; y < std::min(gridHeight, (texelY + 1) * fieldTextureScale); y++)
         {
             for (int x = 0; x < gridWidth; x++)
             {
-                if (tileIsReachable(x, y))
-                {
-                    createFlowArrows(window, x, y, grid[y][x].flowDirection);
-                }
+                sf::Color color = getTileColor(x, y);
+                int* sum = &rowSums[(x / fieldTextureScale) * 4];
+                sum[0] += color.r;
+                sum[1] += color.g;
+                sum[2] += color.b;
+                sum[3]++;
             }
         }
-    }
 
-    drawShortestPath(window);
+        for (int texelX = 0; texelX < textureWidth; texelX++)
+        {
+            const int* sum = &rowSums[texelX * 4];
+            std::uint8_t* pixel = &fieldPixels[(texelY * textureWidth + texelX) * 4];
+            pixel[0] = static_cast<std::uint8_t>(sum[0] / sum[3]);
+            pixel[1] = static_cast<std::uint8_t>(sum[1] / sum[3]);
+            pixel[2] = static_cast<std::uint8_t>(sum[2] / sum[3]);
+        }
+    }
 
-    // Draw NPC
-    if (npcActive)
+    sf::Vector2u textureSize(textureWidth, textureHeight);
+    if (fieldTexture.getSize() != textureSize && !fieldTexture.resize(textureSize))
     {
-        window.draw(npc);
+        std::cout << "Error creating field texture." << std::endl;
+        return;
     }
 
-    // Draw UI
-    window.draw(UIBox);
-    window.draw(instructionsText);
+    fieldTexture.setSmooth(smoothFieldTexture);
+
+    fieldTexture.update(fieldPixels.data());
+    fieldTextureDirty = false;
+}
+
+sf::IntRect FlowField::getVisibleTiles() const
+{
+    sf::View camera = getCameraView();
+    sf::Vector2f topLeft = camera.getCenter() - camera.getSize() / 2.0f;
+    sf::Vector2f bottomRight = camera.getCenter() + camera.getSize() / 2.0f;
+
+    // Tiles partly inside the view count as visible
+    int firstX = std::max(0, static_cast<int>(std::floor((topLeft.x - UI_WIDTH) / tileSize)));
+    int firstY = std::max(0, static_cast<int>(std::floor(topLeft.y / tileSize)));
+    int lastX = std::min(gridWidth, static_cast<int>(std::ceil((bottomRight.x - UI_WIDTH) / tileSize)));
+    int lastY = std::min(gridHeight, static_cast<int>(std::ceil(bottomRight.y / tileSize)));
+
+    return sf::IntRect({ firstX, firstY }, { std::max(0, lastX - firstX), std::max(0, lastY - firstY) });
+}
+
+sf::View FlowField::getCameraView() const
+{
+    // The grid gets the part of the window right of the UI panel
+    sf::Vector2f viewportSize(std::max(1.0f, windowSize.x - UI_WIDTH), windowSize.y);
+
+    sf::View camera(cameraTopLeft + viewportSize / (2.0f * cameraZoom), viewportSize / cameraZoom);
+    camera.setViewport(sf::FloatRect({ UI_WIDTH / windowSize.x, 0.0f }, { viewportSize.x / windowSize.x, 1.0f }));
+    return camera;
+}
+
+void FlowField::panCamera(sf::Vector2f screenOffset)
+{
+    cameraTopLeft += screenOffset / cameraZoom;
+}
+
+void FlowField::zoomCamera(float factor, sf::Vector2f screenPos)
+{
+    // Keep the world point under the cursor where it is on screen
+    sf::Vector2f viewportPos = screenPos - sf::Vector2f(UI_WIDTH, 0.0f);
+    sf::Vector2f worldPos = cameraTopLeft + viewportPos / cameraZoom;
+
+    // Zooming out stops once the whole grid fits in half the viewport
+    sf::Vector2f viewportSize(std::max(1.0f, windowSize.x - UI_WIDTH), windowSize.y);
+    float fitZoom = std::min(viewportSize.x / (gridWidth * tileSize), viewportSize.y / (gridHeight * tileSize));
+    float minZoom = std::min(fitZoom / 2.0f, MAX_CAMERA_ZOOM);
+
+    cameraZoom = std::max(minZoom, std::min(MAX_CAMERA_ZOOM, cameraZoom * factor));
+    cameraTopLeft = worldPos - viewportPos / cameraZoom;
+}
+
+void FlowField::resetCamera()
+{
+    cameraTopLeft = gridToWorld(0, 0);
+    cameraZoom = 1.0f;
+}
+
+sf::Vector2i FlowField::getFlowDirection(int index) const
+{
+    if (connectivity == Connectivity::FOUR)
+        return getFlowDirection<FourConnected>(index);
+
+    return getFlowDirection<EightConnected>(index);
 }
 
-sf::Vector2i FlowField::getFlowDirection(int x, int y) const
+template <typename Neighbourhood>
+sf::Vector2i FlowField::getFlowDirection(int index) const
 {
+    int x = indexToX(index);
+    int y = indexToY(index);
+
     // Goal tile has no direction
     if (x == goalPosition.x && y == goalPosition.y)
         return { 0, 0 };
 
     // Unreachable tiles have no direction
-    if (grid[y][x].integrationCost < 0.0f)
+    if (grid[index].integrationCost < 0)
         return { 0, 0 };
 
     int bestDirection = -1;
-    float bestCost = 9999999.0f;
-    float bestEuclidean = 999999.0f;
+    int bestCost = std::numeric_limits<int>::max();
+    int bestEuclidean = std::numeric_limits<int>::max();
 
     // Find neighbour with lowest integration cost
-    for (int i = 0; i < NEIGHBOUR_COUNT; i++)
+    for (int i = 0; i < Neighbourhood::COUNT; i++)
     {
-        int neighbourX = x + DX[i];
-        int neighbourY = y + DY[i];
+        int neighbour = index + neighbourOffset[i];
 
-        if (!isValid(neighbourX, neighbourY))
+        if (!tileIsReachable(neighbour))
             continue;
 
-        if (!tileIsReachable(neighbourX, neighbourY))
-            continue;
+        if constexpr (Neighbourhood::HAS_DIAGONALS)
+        {
+            if (isDiagonalBlocked(index, i))
+                continue;
+        }
 
-        if (isDiagonalBlocked(x, y, neighbourX, neighbourY))
+        // Only step downhill on the cost field. The Euclidean term alone can make two tiles
+        // point at each other, so this keeps every walk strictly decreasing and loop free.
+        if (grid[neighbour].cost >= grid[index].cost)
             continue;
 
-        float neighbourCost = grid[neighbourY][neighbourX].integrationCost;
+        int neighbourCost = grid[neighbour].integrationCost;
 
-        // Update Euclidean distance for a potential tiebreaker
-        float dx = static_cast<float>(neighbourX - goalPosition.x);
-        float dy = static_cast<float>(neighbourY - goalPosition.y);
-        float euclideanDist = dx * dx + dy * dy;
+        // Update Euclidean distance for a potential tiebreaker, squared so it stays exact
+        int dx = x + DX[i] - goalPosition.x;
+        int dy = y + DY[i] - goalPosition.y;
+        int euclideanDist = dx * dx + dy * dy;
 
 		// If this neighbouring tile has a lower cost, or same cost but closer to goal, move to it
         if (neighbourCost < bestCost)
@@ -497,8 +2337,13 @@ void FlowField::resetNPC()
 
 void FlowField::calculateShortestPath()
 {
+    ScopedStageTimer timer(stats, FlowFieldStats::Stage::SHORTEST_PATH);
     shortestPath.clear();
 
+    // Every field or start change ends up here, so the field texture picks them up on its next draw
+    fieldTextureDirty = true;
+    stats.counters.pathLength = 0;
+
 	// Make sure start and goal are valid first
     if (!isValid(startPosition.x, startPosition.y) ||
         !isValid(goalPosition.x, goalPosition.y))
@@ -506,6 +2351,12 @@ void FlowField::calculateShortestPath()
         return;
     }
 
+    // Start and goal in different regions can never be joined, so skip walking the field
+    if (!isReachable(startPosition, goalPosition))
+    {
+        return;
+    }
+
     sf::Vector2i currentPos = startPosition;
 	shortestPath.push_back(currentPos);
 
@@ -515,7 +2366,7 @@ void FlowField::calculateShortestPath()
     while (currentPos != goalPosition && steps < maxSteps)
     {
         // Get the flow direction for current tile
-        sf::Vector2i flowDir = grid[currentPos.y][currentPos.x].flowDirection;
+        sf::Vector2i flowDir = tileAt(currentPos.x, currentPos.y).flowDirection;
 
         // If no flow direction, path is invalid
         if (flowDir.x == 0 && flowDir.y == 0)
@@ -527,8 +2378,8 @@ void FlowField::calculateShortestPath()
         currentPos.x += flowDir.x;
         currentPos.y += flowDir.y;
 
-        // Validate new position
-        if (!isValid(currentPos.x, currentPos.y) || tileIsObstacle(currentPos.x, currentPos.y))
+        // Validate new position, the obstacle border also catches anything pointing off the grid
+        if (tileIsObstacle(currentPos.x, currentPos.y))
         {
             break;
         }
@@ -542,6 +2393,8 @@ void FlowField::calculateShortestPath()
 		// Need to clear the vector if pathfinding to goal node failed
         shortestPath.clear(); 
 	}
+
+    stats.counters.pathLength = static_cast<int>(shortestPath.size());
 }
 
 void FlowField::drawShortestPath(sf::RenderWindow& window)
@@ -551,32 +2404,32 @@ void FlowField::drawShortestPath(sf::RenderWindow& window)
         return;
     }
 
-    // Draw path as connected line segments
+    // Draw path as connected line segments in one batch
+    lineVertices.clear();
     for (size_t i = 0; i < shortestPath.size() - 1; i++)
     {
-        sf::Vector2f start = getTileCenter(shortestPath[i].x, shortestPath[i].y);
-        sf::Vector2f end = getTileCenter(shortestPath[i + 1].x, shortestPath[i + 1].y);
-
-        // Draw thick yellow line
-        sf::VertexArray line(sf::PrimitiveType::Lines, 2);
-        line[0].position = start;
-        line[0].color = sf::Color(255, 255, 0, 180); // Semi-transparent yellow
-        line[1].position = end;
-        line[1].color = sf::Color(255, 255, 0, 180);
-
-        window.draw(line);
+        lineVertices.append(sf::Vertex{ getTileCenter(shortestPath[i].x, shortestPath[i].y), sf::Color(255, 255, 0, 180) });
+        lineVertices.append(sf::Vertex{ getTileCenter(shortestPath[i + 1].x, shortestPath[i + 1].y), sf::Color(255, 255, 0, 180) });
     }
+    drawCounted(window, lineVertices);
+
+    // Draw dots at each visible path node for clarity, once tiles are big enough to see them
+    if (tileSize * cameraZoom < MIN_ARROW_TILE_PIXELS)
+        return;
 
-    // Draw dots at each path node for clarity
+    sf::IntRect visibleTiles = getVisibleTiles();
     for (const auto& node : shortestPath)
     {
+        if (!visibleTiles.contains(node))
+            continue;
+
         sf::CircleShape dot(tileSize / 8.0f);
         dot.setFillColor(sf::Color(255, 255, 0, 220));
         dot.setOutlineColor(sf::Color(200, 200, 0));
         dot.setOutlineThickness(1.0f);
         dot.setOrigin(sf::Vector2f(dot.getRadius(), dot.getRadius()));
         dot.setPosition(getTileCenter(node.x, node.y));
-        window.draw(dot);
+        drawCounted(window, dot);
     }
 }
 
@@ -605,6 +2458,12 @@ void FlowField::findPath(sf::Time deltaTime)
     {
         npcPos = targetPos;
         currentPathIndex++;  // Move to next tile in path
+
+        // Once the goal is in sight, skip the rest of the path and head straight for it
+        if (lineOfSight[tileIndex(targetTile.x, targetTile.y)] && !shortestPath.empty())
+        {
+            currentPathIndex = std::max(currentPathIndex, static_cast<int>(shortestPath.size()) - 1);
+        }
     }
     else
     {
@@ -613,37 +2472,177 @@ void FlowField::findPath(sf::Time deltaTime)
         npcPos += normalizedDirection * movement;
     }
 
-    // Update visual position
+    // Update visual position, even sized units are drawn on the corner they are centred on
+    float centreOffset = unitSize % 2 == 0 ? tileSize : tileSize / 2.0f;
     npc.setPosition(sf::Vector2f(
-        npcPos.x * tileSize + tileSize / 2.0f + UI_WIDTH,
-        npcPos.y * tileSize + tileSize / 2.0f));
+        npcPos.x * tileSize + centreOffset + UI_WIDTH,
+        npcPos.y * tileSize + centreOffset));
 
 }
 
-bool FlowField::isDiagonalBlocked(int fromX, int fromY, int toX, int toY) const
+PathTree FlowField::extractPaths(const std::vector<sf::Vector2i>& starts) const
 {
-	// Only check for diagonal moves from (fromX, fromY) to (toX, toY)
-    int dx = toX - fromX;
-    int dy = toY - fromY;
+    ScopedStageTimer timer(stats, FlowFieldStats::Stage::SHORTEST_PATH);
+
+    const int NO_PATH = -1;
+    const int WALKING = -2;
+
+    PathTree tree;
+    tree.entries.assign(starts.size(), NO_PATH);
 
+    if (!isValid(goalPosition.x, goalPosition.y) || grid[tileIndex(goalPosition.x, goalPosition.y)].cost != 0)
+        return tree;
+
+    // Tile index -> node, or NO_PATH for tiles already known to lead nowhere
+    std::unordered_map<int, int> tileNodes;
+    int goalIndex = tileIndex(goalPosition.x, goalPosition.y);
+    tileNodes[goalIndex] = 0;
+    tree.nodes.push_back({ goalPosition, -1, 0 });
+
+    std::vector<int> walk;
+
+    for (size_t start = 0; start < starts.size(); start++)
+    {
+        if (!isValid(starts[start].x, starts[start].y))
+            continue;
+
+        // Follow the directions until the walk joins a tile that was settled before
+        int index = tileIndex(starts[start].x, starts[start].y);
+        walk.clear();
+        int joined = NO_PATH;
+
+        while (true)
+        {
+            auto known = tileNodes.find(index);
+            if (known != tileNodes.end())
+            {
+                // Walking into a tile of this same walk means the directions loop
+                joined = known->second == WALKING ? NO_PATH : known->second;
+                break;
+            }
+
+            sf::Vector2i direction = grid[index].flowDirection;
+            if (grid[index].terrainCost == 255 || (direction.x == 0 && direction.y == 0))
+                break;
+
+            tileNodes[index] = WALKING;
+            walk.push_back(index);
+            index += direction.y * stride + direction.x;
+        }
+
+        // Settle the walk back to front, every tile on it now ends where the walk ended
+        for (auto tile = walk.rbegin(); tile != walk.rend(); ++tile)
+        {
+            if (joined == NO_PATH)
+            {
+                tileNodes[*tile] = NO_PATH;
+                continue;
+            }
+
+            int node = static_cast<int>(tree.nodes.size());
+            tree.nodes.push_back({ sf::Vector2i(indexToX(*tile), indexToY(*tile)), joined, tree.nodes[joined].length + 1 });
+            tileNodes[*tile] = node;
+            joined = node;
+        }
+
+        tree.entries[start] = joined;
+    }
+
+    return tree;
+}
+
+bool FlowField::isDiagonalBlocked(int fromIndex, int direction) const
+{
 	// Ignore non-diagonal moves
-    if (dx == 0 || dy == 0)
+    if (DX[direction] == 0 || DY[direction] == 0)
         return false;
 
     // Check the two adjacent cells that the diagonal crosses
-    // For a diagonal move, both adjacent cells need to be passable
-    bool horizontalBlocked = tileIsObstacle(fromX + dx, fromY);
-    bool verticalBlocked = tileIsObstacle(fromX, fromY + dy);
+    // For a diagonal move, both adjacent cells need to be passable for the current unit size,
+    // otherwise a wider unit's footprint sweeps through the obstacles beside the corner
+    bool horizontalBlocked = !tileIsPassable(fromIndex + DX[direction]);
+    bool verticalBlocked = !tileIsPassable(fromIndex + DY[direction] * stride);
 
     // Diagonal is blocked if either adjacent cell is an obstacle
     return horizontalBlocked || verticalBlocked;
 }
 
+void FlowField::sampleDirections(const sf::Vector2f* positions, sf::Vector2f* directions, size_t count,
+                                 SampleMode mode) const
+{
+    ScopedStageTimer timer(stats, FlowFieldStats::Stage::SAMPLE_DIRECTIONS);
+
+    const float inverseTileSize = 1.0f / tileSize;
+    const float maxX = static_cast<float>(gridWidth);
+    const float maxY = static_cast<float>(gridHeight);
+
+    // Bilinear samples are measured from tile centres rather than tile corners
+    const float centreOffset = (mode == SampleMode::BILINEAR) ? 0.5f : 0.0f;
+
+    float gridX[SAMPLE_BATCH];
+    float gridY[SAMPLE_BATCH];
+
+    for (size_t batchStart = 0; batchStart < count; batchStart += SAMPLE_BATCH)
+    {
+        int batchSize = static_cast<int>(std::min<size_t>(SAMPLE_BATCH, count - batchStart));
+        const sf::Vector2f* batchPositions = positions + batchStart;
+        sf::Vector2f* batchDirections = directions + batchStart;
+
+        // World to grid for the whole batch. No branches so the compiler can vectorise it, positions
+        // off the map are clamped onto the obstacle border, which never has a flow direction.
+        for (int i = 0; i < batchSize; i++)
+        {
+            gridX[i] = std::clamp((batchPositions[i].x - UI_WIDTH) * inverseTileSize - centreOffset, -1.0f, maxX);
+            gridY[i] = std::clamp(batchPositions[i].y * inverseTileSize - centreOffset, -1.0f, maxY);
+        }
+
+        if (mode == SampleMode::NEAREST)
+        {
+            for (int i = 0; i < batchSize; i++)
+            {
+                int x = static_cast<int>(std::floor(gridX[i]));
+                int y = static_cast<int>(std::floor(gridY[i]));
+                batchDirections[i] = unitFlowDirection(tileIndex(x, y));
+            }
+            continue;
+        }
+
+        for (int i = 0; i < batchSize; i++)
+        {
+            // Keep the top left corner inside the grid so the bottom right one is at most the border
+            int x = std::min(static_cast<int>(std::floor(gridX[i])), gridWidth - 1);
+            int y = std::min(static_cast<int>(std::floor(gridY[i])), gridHeight - 1);
+            float tx = gridX[i] - x;
+            float ty = gridY[i] - y;
+
+            int index = tileIndex(x, y);
+            sf::Vector2f top = unitFlowDirection(index) * (1.0f - tx) + unitFlowDirection(index + 1) * tx;
+            sf::Vector2f bottom = unitFlowDirection(index + stride) * (1.0f - tx) +
+                unitFlowDirection(index + stride + 1) * tx;
+
+            // Tiles without flow pull the blend towards zero, so rescale it back to unit length unless
+            // almost all of the weight sits on such tiles (at the goal or against a wall)
+            sf::Vector2f blend = top * (1.0f - ty) + bottom * ty;
+            float lengthSquared = blend.x * blend.x + blend.y * blend.y;
+            batchDirections[i] = lengthSquared > MIN_SAMPLE_BLEND * MIN_SAMPLE_BLEND ? normalizeVector(blend)
+                                                                                     : sf::Vector2f(0.0f, 0.0f);
+        }
+    }
+}
+
+void FlowField::sampleDirections(const std::vector<sf::Vector2f>& positions, std::vector<sf::Vector2f>& directions,
+                                 SampleMode mode) const
+{
+    directions.resize(positions.size());
+    sampleDirections(positions.data(), directions.data(), positions.size(), mode);
+}
+
 // Helper functions
 sf::Vector2i FlowField::worldToGrid(sf::Vector2f worldPos) const
 {
-    return sf::Vector2i(static_cast<int>((worldPos.x - UI_WIDTH) / tileSize),
-        static_cast<int>(worldPos.y / tileSize));
+    // Floor rather than truncate, so positions just left of or above the grid stay off it
+    return sf::Vector2i(static_cast<int>(std::floor((worldPos.x - UI_WIDTH) / tileSize)),
+        static_cast<int>(std::floor(worldPos.y / tileSize)));
 }
 
 sf::Vector2f FlowField::gridToWorld(int x, int y) const
@@ -657,24 +2656,96 @@ sf::Vector2f FlowField::getTileCenter(int x, int y) const
         y * tileSize + tileSize / 2.0f);
 }
 
+int FlowField::tileIndex(int x, int y) const
+{
+    // Grid coordinates are shifted by one to make room for the obstacle border
+    return (y + 1) * stride + x + 1;
+}
+
+int FlowField::indexToX(int index) const
+{
+    return index % stride - 1;
+}
+
+int FlowField::indexToY(int index) const
+{
+    return index / stride - 1;
+}
+
+Tile& FlowField::tileAt(int x, int y)
+{
+    return grid[tileIndex(x, y)];
+}
+
+const Tile& FlowField::tileAt(int x, int y) const
+{
+    return grid[tileIndex(x, y)];
+}
+
+bool FlowField::tileIsPassable(int x, int y) const
+{
+    return tileIsPassable(tileIndex(x, y));
+}
+
+bool FlowField::tileIsPassable(int index) const
+{
+    if (grid[index].terrainCost == 255 || clearance[index] < minClearance)
+        return false;
+
+    // Even sized units sit on the corner below and to the right of the tile, so the other three
+    // tiles around that corner need the same clearance. The border keeps the last row and column out.
+    return unitSize % 2 != 0 ||
+           std::min({ clearance[index + 1], clearance[index + stride], clearance[index + stride + 1] }) >= minClearance;
+}
+
+int FlowField::stepCost(int index) const
+{
+    return grid[index].terrainCost + dynamicCost[index] + softCost[index];
+}
+
+bool FlowField::hasStepCosts() const
+{
+    return useDynamicCost || softCostTiles > 0;
+}
+
 bool FlowField::isValid(int x, int y) const
 {
     return x >= 0 && x < gridWidth && y >= 0 && y < gridHeight;
 }
 
-bool FlowField::mouseIsInUI(sf::Vector2f mousePos) const
+bool FlowField::isInUI(sf::Vector2f screenPos) const
 {
-    return mousePos.x < UI_WIDTH;
+    return screenPos.x < UI_WIDTH;
 }
 
 bool FlowField::tileIsObstacle(int x, int y) const
 {
-    return grid[y][x].terrainCost == 255;
+    return tileAt(x, y).terrainCost == 255;
 }
 
 bool FlowField::tileIsReachable(int x, int y) const
 {
-    return !tileIsObstacle(x, y) && grid[y][x].integrationCost >= 0.0f;
+    return tileIsReachable(tileIndex(x, y));
+}
+
+bool FlowField::tileIsReachable(int index) const
+{
+    return grid[index].terrainCost != 255 && grid[index].integrationCost >= 0;
+}
+
+sf::Vector2f FlowField::unitFlowDirection(int index) const
+{
+    const float INV_SQRT2 = 0.70710678f;
+
+    if (lineOfSight[index])
+    {
+        sf::Vector2i toGoal(goalPosition.x - indexToX(index), goalPosition.y - indexToY(index));
+        return normalizeVector(sf::Vector2f(toGoal));
+    }
+
+    sf::Vector2i direction = grid[index].flowDirection;
+    float scale = (direction.x != 0 && direction.y != 0) ? INV_SQRT2 : 1.0f;
+    return sf::Vector2f(direction.x * scale, direction.y * scale);
 }
 
 sf::Vector2f FlowField::normalizeVector(sf::Vector2f vec) const
@@ -687,12 +2758,69 @@ sf::Vector2f FlowField::normalizeVector(sf::Vector2f vec) const
     return sf::Vector2f(0.0f, 0.0f);
 }
 
+void FlowField::drawCounted(sf::RenderWindow& window, const sf::Drawable& drawable) const
+{
+    stats.counters.drawCalls++;
+    window.draw(drawable);
+}
+
+int FlowField::getGridWidth() const
+{
+    return gridWidth;
+}
+
+int FlowField::getGridHeight() const
+{
+    return gridHeight;
+}
+
+const Tile& FlowField::getTile(int x, int y) const
+{
+    return tileAt(x, y);
+}
+
+int FlowField::getDynamicCost(int x, int y) const
+{
+    return dynamicCost[tileIndex(x, y)];
+}
+
+int FlowField::getSoftCost(int x, int y) const
+{
+    return softCost[tileIndex(x, y)];
+}
+
+bool FlowField::hasSoftCost() const
+{
+    return softCostTiles > 0;
+}
+
+sf::Vector2i FlowField::getGoalTile() const
+{
+    return goalPosition;
+}
+
+const std::vector<sf::Vector2i>& FlowField::getShortestPath() const
+{
+    return shortestPath;
+}
+
+const FlowFieldStats& FlowField::getStats() const
+{
+    return stats;
+}
+
+bool FlowField::dumpStats(const std::string& path) const
+{
+    return stats.dumpCsv(path);
+}
+
 bool FlowField::loadFont(const std::string& fontPath)
 {
     if (uiFont.openFromFile(fontPath))
     {
         instructionsText.setFont(uiFont);
         costText.setFont(uiFont);
+        statsText.setFont(uiFont);
         return true;
     }
     return false;
@@ -704,6 +2832,7 @@ void FlowField::toggleCostField()
         displayMode = DisplayMode::NONE;
     else
         displayMode = DisplayMode::COST_FIELD;
+    fieldTextureDirty = true;
 }
 
 void FlowField::toggleIntegrationField()
@@ -712,14 +2841,27 @@ void FlowField::toggleIntegrationField()
         displayMode = DisplayMode::NONE;
     else
         displayMode = DisplayMode::INTEGRATION_FIELD;
+    fieldTextureDirty = true;
 }
 
 void FlowField::toggleHeatmap()
 {
     showHeatmap = !showHeatmap;
+    fieldTextureDirty = true;
 }
 
 void FlowField::toggleVectorField()
 {
     showVectorField = !showVectorField;
+}
+
+void FlowField::toggleFieldSmoothing()
+{
+    smoothFieldTexture = !smoothFieldTexture;
+    fieldTexture.setSmooth(smoothFieldTexture);
+}
+
+void FlowField::toggleStats()
+{
+    showStats = !showStats;
 }
\ No newline at end of file
@@ -2,16 +2,58 @@
 #define FLOWFIELD_HPP
 
 #include <SFML/Graphics.hpp>
+#include <array>
 #include <vector>
+#include <queue>
+#include <functional>
+#include <cstdint>
+#include "FlowFieldStats.h"
+#include "FlowFieldPolicies.h"
 
 struct Tile
 {
     int terrainCost = 1;                    // Terrain traversal cost: 1 = passable, 255 = obstacle
     int cost = -1;                          // (Step 1 Cost Field) Path distance from goal. -1 = unvisited
-    float integrationCost = -1.0f;          // (Step 2 Integration Field) Euclidean + cost field. -1 = unvisited
+    int integrationCost = -1;               // (Step 2 Integration Field) Distance + cost field. -1 = unvisited
     sf::Vector2i flowDirection = {0, 0};    // (Step 3 Vector field) Direction to lowest integration cost neighbor
 };
 
+// Cost, integration and direction fields for several goals computed in one sweep. The values of
+// every goal for one tile sit next to each other, so neighbour loads are shared between goals.
+struct MultiGoalFields
+{
+    int stride = 0;                         // Row length of the padded grid the fields were built on
+    int goalCount = 0;
+    std::vector<int> costs;                 // -1 = unreachable from this tile
+    std::vector<std::int32_t> integrationCosts;     // -1 = unreachable from this tile
+    std::vector<std::int8_t> directions;    // (dy + 1) * 3 + (dx + 1), so 4 means no direction
+
+    int getCost(int x, int y, int goal) const;
+    int getIntegrationCost(int x, int y, int goal) const;
+    sf::Vector2i getFlowDirection(int x, int y, int goal) const;
+
+private:
+    int valueIndex(int x, int y, int goal) const;
+};
+
+// Paths from many starts to one goal, stored as a tree rooted at the goal. Every tile on any path
+// is a single node pointing at the next tile, so paths that meet share everything after that point.
+struct PathTree
+{
+    struct Node
+    {
+        sf::Vector2i tile;
+        int next;                           // Node one step nearer the goal, -1 at the goal
+        int length;                         // Steps left to the goal
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> entries;               // Node for each start in request order, -1 when it has no path
+
+    // Tiles from the start to the goal, both included, or nothing when the start has no path
+    std::vector<sf::Vector2i> getPath(int start) const;
+};
+
 class FlowField
 {
 public:
@@ -28,20 +70,133 @@ public:
     void createIntegrationField();
 
     // Rendering
-    void createFlowArrows(sf::RenderWindow& window, int x, int y, sf::Vector2i direction) const;
+    void createFlowArrows(sf::VertexArray& lines, int x, int y, sf::Vector2f direction) const;
     void render(sf::RenderWindow& window);
 
+    // Camera over the grid. The UI panel stays fixed on the left of the window, the grid is drawn
+    // through the camera view and only tiles inside it are emitted.
+    void panCamera(sf::Vector2f screenOffset);
+    void zoomCamera(float factor, sf::Vector2f screenPos);
+    void resetCamera();
+    sf::View getCameraView() const;
+    bool isInUI(sf::Vector2f screenPos) const;
+
 	// User interactions with the flowfield
     void setStart(sf::Vector2f worldPos);
     void setGoal(sf::Vector2f worldPos);
 	void toggleObstacle(sf::Vector2f worldPos);
     bool loadFont(const std::string& fontPath);
 
+    // Grid coordinate access for tools that drive the flowfield without a mouse
+    bool setStartTile(sf::Vector2i gridPos);
+    bool setGoalTile(sf::Vector2i gridPos);
+    bool buildGoalField(sf::Vector2i gridPos);      // setGoalTile without the start check, for field only tools
+    void loadTerrain(const std::vector<std::uint8_t>& terrainCosts);    // One terrain cost per tile, row by row
+    bool loadMap(const std::string& path);          // MapGenerator map file, the grid takes the map's size
+    bool saveMap(const std::string& path) const;
+    int getGridWidth() const;
+    int getGridHeight() const;
+    const Tile& getTile(int x, int y) const;
+    int getDynamicCost(int x, int y) const;
+    sf::Vector2i getGoalTile() const;
+    const std::vector<sf::Vector2i>& getShortestPath() const;
+
+    // Field snapshots for caching, one entry per tile row by row. Directions use the same
+    // (dy + 1) * 3 + (dx + 1) code as MultiGoalFields.
+    std::uint64_t getTerrainHash() const;
+    void exportField(std::vector<std::int32_t>& costs, std::vector<std::int32_t>& integrationCosts,
+                     std::vector<std::int8_t>& directions) const;
+    bool importField(sf::Vector2i goal, const std::int32_t* costs, const std::int32_t* integrationCosts,
+                     const std::int8_t* directions);
+
+    // Paths along the direction field for many starts at once. Each tile is walked at most once, so
+    // the cost follows the number of distinct tiles rather than the sum of the path lengths.
+    PathTree extractPaths(const std::vector<sf::Vector2i>& starts) const;
+
+    // Fields for several goals at once (plain BFS cost with the current unit size, no congestion)
+    MultiGoalFields createMultiGoalFields(const std::vector<sf::Vector2i>& goals) const;
+
+    // Bounded generation: the wavefront stops once every agent tile is settled and all tiles up to
+    // 'margin' cost steps past the furthest agent are final. Agents outside the covered area resume
+    // the same wavefront. Full rebuilds (terrain edits, unit size changes) go back to a complete field.
+    bool setGoalTileBounded(sf::Vector2i gridPos, const std::vector<sf::Vector2i>& agentTiles, int margin);
+    void expandCostField(const std::vector<sf::Vector2i>& agentTiles);
+    bool isCostFieldBounded() const;
+
     // Display toggles
     void toggleCostField();
     void toggleHeatmap();
     void toggleIntegrationField();
     void toggleVectorField();
+    void toggleFieldSmoothing();            // Nearest or smooth filtering for the field texture
+    void toggleStats();
+
+    // Per-stage timings and work counters
+    const FlowFieldStats& getStats() const;
+    bool dumpStats(const std::string& path) const;
+
+    // Reachability: true when both tiles are passable and in the same connected region
+    bool isReachable(sf::Vector2i from, sf::Vector2i to) const;
+
+    // Unit size classes: fields only use tiles with enough clearance for the current unit size.
+    // Odd sized units are centred on their tile, even sized ones on the corner below and to the
+    // right of it, so every size from 1 to MAX_UNIT_SIZE needs exactly its own width of free space.
+    void setUnitSize(int size);
+    void cycleUnitSize();
+    int getUnitSize() const;
+    int getClearance(int x, int y) const;
+    static int clearanceForSize(int size);
+
+    // Batch steering queries: one unit direction per world position, zero where there is no flow
+    enum class SampleMode
+    {
+        NEAREST,        // Direction of the tile the position falls in
+        BILINEAR        // Blend of the four surrounding tile centres
+    };
+    void sampleDirections(const sf::Vector2f* positions, sf::Vector2f* directions, size_t count,
+                          SampleMode mode) const;
+    void sampleDirections(const std::vector<sf::Vector2f>& positions, std::vector<sf::Vector2f>& directions,
+                          SampleMode mode) const;
+
+    // Distance term of the integration field. Euclidean uses floating point square roots, fixed
+    // octile is integer only and gives identical fields on every machine for lockstep simulations.
+    enum class IntegrationMode
+    {
+        EUCLIDEAN,
+        FIXED_OCTILE
+    };
+    void setIntegrationMode(IntegrationMode mode);
+    void toggleIntegrationMode();
+    IntegrationMode getIntegrationMode() const;
+
+    // Moves the wavefront and directions may use. Four connected grids skip every diagonal check.
+    enum class Connectivity
+    {
+        FOUR,
+        EIGHT
+    };
+    void setConnectivity(Connectivity connectivity);
+    void toggleConnectivity();
+    Connectivity getConnectivity() const;
+
+    // Line of sight: tiles with a clear straight line to the goal steer straight at it instead of
+    // along one of the eight grid directions. Found with a wavefront out from the goal.
+    void setLineOfSightEnabled(bool enabled);
+    void toggleLineOfSight();
+    bool isLineOfSightEnabled() const;
+    bool hasLineOfSight(int x, int y) const;
+
+    // Congestion: splat agent density into a dynamic cost layer added on top of terrainCost
+    void setDynamicCostEnabled(bool enabled);
+    bool isDynamicCostEnabled() const;
+    void updateDynamicCost(const std::vector<sf::Vector2f>& agentPositions,
+                           const std::vector<sf::Vector2f>& agentVelocities);
+
+    // Soft cost layer written by other systems (influence maps), added to terrainCost on top of
+    // congestion. costs holds rowCount rows of gridWidth values. Changed tiles are repaired in place.
+    void setSoftCostRows(int firstRow, int rowCount, const std::uint8_t* costs);
+    int getSoftCost(int x, int y) const;
+    bool hasSoftCost() const;
 
     // Visualization of NPC following the flow field
     void findPath(sf::Time deltaTime);
@@ -64,9 +219,31 @@ private:
 	static constexpr int DX[NEIGHBOUR_COUNT] = { 0, 0, 1, -1, -1, 1, -1, 1 };
 	static constexpr int DY[NEIGHBOUR_COUNT] = { -1, 1, 0, 0, -1, -1, 1, 1 };
 
+    // Dynamic cost tuning (continuum crowds style discomfort)
+    static constexpr float DENSITY_COMFORT = 0.5f;          // Agents per tile before the tile starts costing more
+    static constexpr float DENSITY_COST_WEIGHT = 4.0f;      // Extra cost per agent above the comfort level
+    static constexpr int MAX_DYNAMIC_COST = 64;
+    static constexpr float DENSITY_LOOKAHEAD = 0.5f;        // Seconds ahead to splat predicted positions
+    static constexpr float DENSITY_LOOKAHEAD_WEIGHT = 0.5f;
+    static constexpr int PARALLEL_SPLAT_THRESHOLD = 4096;   // Agent count before splatting is split across threads
+
+    static constexpr int MAX_UNIT_SIZE = 4;                 // Largest unit size class in tiles
+    static constexpr int MAX_CLEARANCE = 255;               // Clearance is stored in a byte per tile
+
+    static constexpr int SAMPLE_BATCH = 256;                // Positions converted to grid space per pass when sampling
+    static constexpr float MIN_SAMPLE_BLEND = 0.01f;        // Shorter bilinear blends are treated as no flow
+
+    using LaneMask = std::uint64_t;                         // One bit per goal when sweeping several goals together
+    static constexpr int MULTI_GOAL_LANES = 64;
+
+    using CostQueueEntry = std::pair<int, int>;             // (cost, tile index)
+    using CostQueue = std::priority_queue<CostQueueEntry, std::vector<CostQueueEntry>, std::greater<CostQueueEntry>>;
+
     int gridWidth;
     int gridHeight;
     float tileSize;
+    int stride;                                 // Row length of the padded grid (gridWidth + 2)
+    int neighbourOffset[NEIGHBOUR_COUNT];       // DX/DY as linear index offsets into the padded grid
 
 	int maxCostValue{ 0 };          // Maximum cost value for heatmap scaling so that colors are relative to current costs
     bool showHeatmap = false;
@@ -76,8 +253,46 @@ private:
     sf::Vector2i startPosition{ -1, -1 };
     sf::Vector2i goalPosition{ -1, -1 };
 
-    std::vector<std::vector<Tile>> grid;            // Grid of tiles for flowfield positions and costs
-    std::vector<sf::RectangleShape> tileShapes;     // Visualization of squares on top of the grid
+    // Grid of tiles for flowfield positions and costs, stored row by row with a one tile border of
+    // obstacles. Every per-tile array below uses the same padded layout, see tileIndex().
+    std::vector<Tile> grid;
+
+    // Clearance (Chebyshev distance to the nearest obstacle or map edge)
+    std::vector<std::uint8_t> clearance;
+    int unitSize = 1;
+    int minClearance = 1;                           // Clearance a tile needs to be used by the current unit size
+
+    // FNV-1a hash of the terrain, recomputed on demand after terrain edits
+    mutable std::uint64_t terrainHash = 0;
+    mutable bool terrainHashDirty = true;
+
+    // Connected regions of passable tiles as a union-find forest.
+    // Mutable so that const reachability queries can still compress paths.
+    mutable std::vector<int> componentParent;
+
+    IntegrationMode integrationMode = IntegrationMode::EUCLIDEAN;
+    Connectivity connectivity = Connectivity::EIGHT;
+
+    // Tiles that can see the goal, only filled in while line of sight is enabled
+    bool useLineOfSight = false;
+    std::vector<std::uint8_t> lineOfSight;
+
+    // Dynamic congestion layer
+    bool useDynamicCost = false;
+    std::vector<float> densityField;                // Splatted agent density per tile
+    std::vector<int> dynamicCost;                   // Extra traversal cost per tile derived from density
+    std::vector<int> costParent;                    // Tile each cost was relaxed from, used for incremental repair
+
+    // Soft costs from outside the flowfield
+    std::vector<std::uint8_t> softCost;
+    int softCostTiles = 0;                          // Tiles with a soft cost above zero
+
+    // Bounded generation state
+    bool costFieldBounded = false;
+    int boundedMargin = 0;
+    int coveredCost = -1;                           // Every tile up to this cost is final
+    std::vector<int> expandedTiles;                 // Tiles given a cost so far, so a rebuild only clears those
+    CostQueue costFrontier;                         // Wavefront to resume from
 
     // UI elements
     sf::RectangleShape UIBox;
@@ -85,6 +300,40 @@ private:
     sf::Font uiFont;
     sf::Text instructionsText{ uiFont };
     sf::Text costText{ uiFont };
+    sf::Text statsText{ uiFont };
+    bool showStats = false;
+
+    // Mutable so const drawing helpers can count their draw calls
+    mutable FlowFieldStats stats;
+
+    // Camera: world position at the top left of the grid viewport, and screen pixels per world unit
+    sf::Vector2f cameraTopLeft;
+    float cameraZoom = 1.0f;
+    sf::Vector2f windowSize;                        // Size of the window at the last render
+    static constexpr float MAX_CAMERA_ZOOM = 4.0f;
+
+    // Level of detail by on-screen tile size in pixels
+    static constexpr float MIN_TILE_PIXELS = 1.0f;          // Smaller tiles use the field texture
+    static constexpr float MIN_OUTLINE_TILE_PIXELS = 4.0f;
+    static constexpr float MIN_ARROW_TILE_PIXELS = 8.0f;
+    static constexpr float MIN_TEXT_TILE_PIXELS = 24.0f;
+
+    // Geometry for the visible tiles, rebuilt every frame
+    sf::VertexArray tileVertices{ sf::PrimitiveType::Triangles };
+    sf::VertexArray lineVertices{ sf::PrimitiveType::Lines };
+
+    // Picture of the whole grid, one texel per tile, for the heatmap, cost and integration views and
+    // for zoomed out views. Grids too big for one texel per tile are downsampled.
+    static constexpr int MAX_FIELD_TEXTURE_SIZE = 2048;
+    sf::Texture fieldTexture;
+    std::vector<std::uint8_t> fieldPixels;
+    int fieldTextureScale = 1;                      // Tiles per texel along each axis
+    bool fieldTextureDirty = true;
+    bool smoothFieldTexture = false;
+
+    // Heat colours from low to high cost, indexed by value * 255 / heatmapMax
+    std::array<sf::Color, 256> heatmapLut;
+    int heatmapMax = 0;                             // Largest value of the field being shown
 
 	// Entity following the flow field
 	sf::CircleShape npc;
@@ -99,12 +348,61 @@ private:
 
 	// Helper functions
     bool isValid(int x, int y) const;
-    bool mouseIsInUI(sf::Vector2f mousePos) const;
+    sf::Color getTileColor(int x, int y) const;
+    sf::IntRect getVisibleTiles() const;
+    void updateFieldTexture();
+    void createHeatmapLut();
+    bool isFieldViewActive() const;
+    void appendQuad(sf::VertexArray& vertices, sf::Vector2f position, sf::Vector2f size, sf::Color color) const;
+    void drawCounted(sf::RenderWindow& window, const sf::Drawable& drawable) const;
     bool tileIsObstacle(int x, int y) const;
 	bool tileIsReachable(int x, int y) const;
-    sf::Vector2i getFlowDirection(int x, int y) const;
+    bool tileIsReachable(int index) const;
+    sf::Vector2i getFlowDirection(int index) const;
+    int getNeighbourCount() const;
 	sf::Vector2f normalizeVector(sf::Vector2f vec) const;
-	bool isDiagonalBlocked(int fromX, int fromY, int toX, int toY) const;
+    sf::Vector2f unitFlowDirection(int index) const;
+	bool isDiagonalBlocked(int fromIndex, int direction) const;
+    int tileIndex(int x, int y) const;
+    int indexToX(int index) const;
+    int indexToY(int index) const;
+    Tile& tileAt(int x, int y);
+    const Tile& tileAt(int x, int y) const;
+    bool tileIsPassable(int x, int y) const;
+    bool tileIsPassable(int index) const;
+    void resizeGrid(int w, int h);
+    void createClearanceField();
+    void updateClearance(int x, int y);
+    void createComponents();
+    void updateComponents(int x, int y);
+    int findComponent(int index) const;
+    void mergeComponents(int first, int second);
+    bool closingSplitsRegion(int x, int y) const;
+    int stepCost(int index) const;
+    bool hasStepCosts() const;                      // Steps cost more than 1 somewhere, so fields need Dijkstra
+    void updateIntegrationCost(int x, int y);
+    int getIntegrationCost(int cost, int dx, int dy) const;
+    void updateIntegrationTiles(const std::vector<int>& touchedTiles);
+    void createLineOfSight();
+    void updateLineOfSight(int firstRing);          // Redoes rings firstRing and further from the goal
+    void createBoundedCostField(const std::vector<sf::Vector2i>& agentTiles, int margin);
+    void expandBoundedField(const std::vector<sf::Vector2i>& agentTiles, std::vector<int>& touchedTiles);
+    static int lowestLane(LaneMask lanes);
+    std::vector<std::uint8_t> createMoveMasks() const;
+    void sweepMultiGoalCosts(const std::vector<sf::Vector2i>& goals, int firstGoal, int laneCount,
+                             const std::vector<std::uint8_t>& moveMasks, MultiGoalFields& fields) const;
+    void createWeightedCostField();
+    void relaxCostField(CostQueue& openTiles, std::vector<int>* touchedTiles);
+
+    // Policy kernels behind the functions above, see FlowFieldPolicies.h
+    template <typename Neighbourhood> void sweepCostField(int goalIndex);
+    template <typename Neighbourhood> void relaxCostField(CostQueue& openTiles, std::vector<int>* touchedTiles);
+    template <typename Neighbourhood, typename Metric> void integrateField();
+    template <typename Neighbourhood> sf::Vector2i getFlowDirection(int index) const;
+    void repairCostField(const std::vector<int>& raisedTiles, const std::vector<int>& loweredTiles);
+    void splatAgentDensity(const std::vector<sf::Vector2f>& agentPositions,
+                           const std::vector<sf::Vector2f>& agentVelocities);
+    void splatPoint(std::vector<float>& density, sf::Vector2f worldPos, float weight) const;
 };
 
 #endif
\ No newline at end of file
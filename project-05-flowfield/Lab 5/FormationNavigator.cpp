@@ -0,0 +1,292 @@
+#include "FormationNavigator.h"
+#include "Flowfield.h"
+#include "GridRaycaster.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    float length(sf::Vector2f vector)
+    {
+        return std::sqrt(vector.x * vector.x + vector.y * vector.y);
+    }
+
+    sf::Vector2f tileCentre(int x, int y)
+    {
+        return sf::Vector2f(x + 0.5f, y + 0.5f);
+    }
+}
+
+FormationNavigator::FormationNavigator(const FlowField& flowField, const GridRaycaster& raycaster, float speed)
+    : flowField(flowField), raycaster(raycaster), speed(speed)
+{
+}
+
+int FormationNavigator::addFormation(sf::Vector2i anchorTile, const std::vector<sf::Vector2f>& slotOffsets)
+{
+    if (anchorTile.x < 0 || anchorTile.x >= flowField.getGridWidth() ||
+        anchorTile.y < 0 || anchorTile.y >= flowField.getGridHeight() ||
+        flowField.getTile(anchorTile.x, anchorTile.y).cost < 0)
+    {
+        return -1;
+    }
+
+    Formation formation;
+    formation.anchor = tileCentre(anchorTile.x, anchorTile.y);
+
+    sf::Vector2i direction = flowField.getTile(anchorTile.x, anchorTile.y).flowDirection;
+    if (direction.x != 0 || direction.y != 0)
+    {
+        formation.heading = sf::Vector2f(direction) / length(sf::Vector2f(direction));
+    }
+
+    // Slots are placed once with no time to expand, so members start wherever their slot fits
+    for (sf::Vector2f offset : slotOffsets)
+    {
+        Slot slot;
+        slot.offset = offset;
+        formation.slots.push_back(slot);
+    }
+
+    for (Slot& slot : formation.slots)
+    {
+        placeSlot(formation, slot, 0.0f);
+        slot.member = slot.position;
+    }
+
+    formations.push_back(std::move(formation));
+    stats.formations++;
+    return static_cast<int>(formations.size()) - 1;
+}
+
+void FormationNavigator::clearFormations()
+{
+    formations.clear();
+    stats = Stats();
+}
+
+void FormationNavigator::update(float deltaSeconds)
+{
+    stats.compressedSlots = 0;
+    stats.reprojectedSlots = 0;
+
+    for (Formation& formation : formations)
+    {
+        updateFormation(formation, deltaSeconds);
+    }
+}
+
+int FormationNavigator::getFormationCount() const
+{
+    return static_cast<int>(formations.size());
+}
+
+sf::Vector2f FormationNavigator::getAnchor(int formation) const
+{
+    return formations[formation].anchor;
+}
+
+sf::Vector2f FormationNavigator::getHeading(int formation) const
+{
+    return formations[formation].heading;
+}
+
+int FormationNavigator::getSlotCount(int formation) const
+{
+    return static_cast<int>(formations[formation].slots.size());
+}
+
+sf::Vector2f FormationNavigator::getSlotPosition(int formation, int slot) const
+{
+    return formations[formation].slots[slot].position;
+}
+
+sf::Vector2f FormationNavigator::getMemberPosition(int formation, int slot) const
+{
+    return formations[formation].slots[slot].member;
+}
+
+float FormationNavigator::getSlotSpread(int formation, int slot) const
+{
+    return formations[formation].slots[slot].spread;
+}
+
+bool FormationNavigator::hasArrived(int formation) const
+{
+    return formations[formation].arrived;
+}
+
+const FormationNavigator::Stats& FormationNavigator::getStats() const
+{
+    return stats;
+}
+
+std::vector<sf::Vector2f> FormationNavigator::getFingerFourOffsets(float spacing)
+{
+    return { { 0.0f, 0.0f },
+             { -spacing, spacing * 0.7f },
+             { spacing, spacing * 0.7f },
+             { spacing * 1.5f, spacing * 1.4f } };
+}
+
+void FormationNavigator::updateFormation(Formation& formation, float deltaSeconds)
+{
+    if (!formation.arrived)
+    {
+        sf::Vector2f previous = formation.anchor;
+        formation.anchor = moveAlongFlow(formation.anchor, speed * deltaSeconds);
+
+        // The heading eases round to the way the anchor actually moved, so slots swing smoothly
+        sf::Vector2f moved = formation.anchor - previous;
+        float movedLength = length(moved);
+        if (movedLength > 0.0f)
+        {
+            sf::Vector2f turned = formation.heading + (moved / movedLength - formation.heading) *
+                                  std::min(1.0f, TURN_RATE * deltaSeconds);
+            float turnedLength = length(turned);
+            formation.heading = turnedLength > 0.001f ? turned / turnedLength : moved / movedLength;
+        }
+
+        sf::Vector2i anchorTile(static_cast<int>(std::floor(formation.anchor.x)), static_cast<int>(std::floor(formation.anchor.y)));
+        if (flowField.getTile(anchorTile.x, anchorTile.y).cost == 0 &&
+            formation.anchor == tileCentre(anchorTile.x, anchorTile.y))
+        {
+            formation.arrived = true;
+            stats.arrived++;
+        }
+    }
+
+    float memberStep = speed * MEMBER_SPEED_FACTOR * deltaSeconds;
+
+    for (Slot& slot : formation.slots)
+    {
+        placeSlot(formation, slot, deltaSeconds);
+
+        if (slot.spread < 1.0f)
+            stats.compressedSlots++;
+
+        // Straight to the slot when nothing is in the way, otherwise round the obstacles like the anchor
+        if (raycaster.isClear(slot.member, slot.position))
+        {
+            slot.member = moveTowards(slot.member, slot.position, memberStep);
+        }
+        else
+        {
+            slot.member = moveAlongFlow(slot.member, memberStep);
+        }
+    }
+}
+
+void FormationNavigator::placeSlot(const Formation& formation, Slot& slot, float deltaSeconds)
+{
+    sf::Vector2f full = getSlotTarget(formation, slot, 1.0f);
+    float offsetLength = length(full - formation.anchor);
+
+    if (offsetLength <= 0.0f)
+    {
+        slot.spread = 1.0f;
+        slot.position = formation.anchor;
+        return;
+    }
+
+    // Everything on the way out to the first obstacle is clear, so the slot can go up to just short
+    // of it. Pulling in is immediate, spreading out again is gradual.
+    GridRaycaster::RayHit hit = raycaster.cast(formation.anchor, full);
+    float fit = hit.blocked ? std::max(MIN_SPREAD, hit.fraction - SLOT_CLEARANCE / offsetLength) : 1.0f;
+    slot.spread = std::min(fit, slot.spread + EXPAND_RATE * deltaSeconds);
+    slot.position = getSlotTarget(formation, slot, slot.spread);
+
+    // A slot pressed right onto the anchor (a wall straight across its offset) goes to the nearest
+    // reachable tile the anchor can see instead, searched ring by ring around where it should be
+    if (slot.spread * offsetLength >= SLOT_CLEARANCE || offsetLength < 1.0f)
+        return;
+
+    int centreX = static_cast<int>(std::floor(full.x));
+    int centreY = static_cast<int>(std::floor(full.y));
+
+    for (int ring = 0; ring <= REPROJECT_RADIUS; ring++)
+    {
+        float bestDistance = -1.0f;
+        sf::Vector2f best;
+
+        for (int y = centreY - ring; y <= centreY + ring; y++)
+        {
+            for (int x = centreX - ring; x <= centreX + ring; x++)
+            {
+                bool onRing = std::abs(x - centreX) == ring || std::abs(y - centreY) == ring;
+                if (!onRing || !isReachable(tileCentre(x, y)))
+                    continue;
+
+                sf::Vector2f candidate = tileCentre(x, y);
+                float distance = length(candidate - full);
+
+                if ((bestDistance < 0.0f || distance < bestDistance) && raycaster.isClear(formation.anchor, candidate))
+                {
+                    bestDistance = distance;
+                    best = candidate;
+                }
+            }
+        }
+
+        if (bestDistance >= 0.0f)
+        {
+            slot.position = best;
+            stats.reprojectedSlots++;
+            return;
+        }
+    }
+}
+
+sf::Vector2f FormationNavigator::moveAlongFlow(sf::Vector2f position, float distance) const
+{
+    // Tile centre to tile centre, the same way a unit follows the flowfield. Heading for the next
+    // centre from anywhere in a tile never crosses a tile the flowfield would not.
+    for (int step = 0; step < 4 && distance > 0.0f; step++)
+    {
+        int x = static_cast<int>(std::floor(position.x));
+        int y = static_cast<int>(std::floor(position.y));
+
+        if (!isReachable(position))
+            return position;
+
+        const Tile& tile = flowField.getTile(x, y);
+        sf::Vector2f target = tile.cost == 0 ? tileCentre(x, y)
+                                             : tileCentre(x + tile.flowDirection.x, y + tile.flowDirection.y);
+
+        float remaining = length(target - position);
+        if (remaining <= 0.0f)
+            return position;
+
+        position = moveTowards(position, target, distance);
+        distance -= remaining;
+    }
+
+    return position;
+}
+
+sf::Vector2f FormationNavigator::getSlotTarget(const Formation& formation, const Slot& slot, float spread) const
+{
+    sf::Vector2f right(-formation.heading.y, formation.heading.x);
+    sf::Vector2f back = -formation.heading;
+    return formation.anchor + (right * slot.offset.x + back * slot.offset.y) * spread;
+}
+
+bool FormationNavigator::isReachable(sf::Vector2f position) const
+{
+    int x = static_cast<int>(std::floor(position.x));
+    int y = static_cast<int>(std::floor(position.y));
+
+    return x >= 0 && x < flowField.getGridWidth() && y >= 0 && y < flowField.getGridHeight() &&
+           flowField.getTile(x, y).cost >= 0;
+}
+
+sf::Vector2f FormationNavigator::moveTowards(sf::Vector2f position, sf::Vector2f target, float distance)
+{
+    sf::Vector2f toTarget = target - position;
+    float remaining = length(toTarget);
+
+    if (remaining <= distance)
+        return target;
+
+    return position + toTarget * (distance / remaining);
+}
@@ -0,0 +1,94 @@
+#ifndef FORMATIONNAVIGATOR_HPP
+#define FORMATIONNAVIGATOR_HPP
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+class FlowField;
+class GridRaycaster;
+
+// Moves formations across the flowfield grid towards its goal. The formation's anchor follows
+// the flowfield from tile centre to tile centre, and each slot sits at its offset from the anchor,
+// turned to the anchor's heading. A slot is pulled in along its offset as far as the obstacles
+// need, so formations squeeze through chokepoints and spread out again at EXPAND_RATE once past.
+// A slot that a wall would press right onto the anchor is moved to the nearest reachable tile
+// the anchor can see instead. Members walk straight to their slot when nothing is in the way,
+// and follow the flowfield when something is.
+//
+// Everything is in tiles, tile (x, y) covers [x, x + 1) x [y, y + 1). A formation costs one pass
+// over its slots per tick, a ray for each slot and member and a small ring search only for slots
+// pressed against a wall, so hundreds of squads can share a field. The raycaster has to match the
+// flowfield's terrain.
+class FormationNavigator
+{
+public:
+    struct Stats
+    {
+        int formations = 0;
+        int arrived = 0;
+        int compressedSlots = 0;        // Slots pulled in by the last update
+        int reprojectedSlots = 0;       // Slots moved to another tile by the last update
+    };
+
+    FormationNavigator(const FlowField& flowField, const GridRaycaster& raycaster, float speed = 4.0f);
+
+    // Offsets are in tiles, x to the right of the heading and y behind the anchor. Members start on
+    // their slots around the anchor tile's centre. Returns -1 when the tile cannot reach the goal.
+    int addFormation(sf::Vector2i anchorTile, const std::vector<sf::Vector2f>& slotOffsets);
+    void clearFormations();
+
+    // Moves every formation by speed * deltaSeconds tiles
+    void update(float deltaSeconds);
+
+    int getFormationCount() const;
+    sf::Vector2f getAnchor(int formation) const;
+    sf::Vector2f getHeading(int formation) const;
+    int getSlotCount(int formation) const;
+    sf::Vector2f getSlotPosition(int formation, int slot) const;
+    sf::Vector2f getMemberPosition(int formation, int slot) const;
+    float getSlotSpread(int formation, int slot) const;     // 1 when the slot is fully out
+    bool hasArrived(int formation) const;
+    const Stats& getStats() const;
+
+    // Lab 4's finger four: leader on the anchor, wings either side behind it and a tail further back
+    static std::vector<sf::Vector2f> getFingerFourOffsets(float spacing);
+
+private:
+    static constexpr float EXPAND_RATE = 0.5f;          // Spread regained per second once clear
+    static constexpr float MIN_SPREAD = 0.0f;
+    static constexpr float SLOT_CLEARANCE = 0.5f;       // Gap kept between a pulled in slot and the wall
+    static constexpr int REPROJECT_RADIUS = 3;          // Tiles searched around a blocked slot
+    static constexpr float TURN_RATE = 6.0f;            // How quickly the heading follows the anchor
+    static constexpr float MEMBER_SPEED_FACTOR = 1.5f;  // Members can catch up with their slots
+
+    struct Slot
+    {
+        sf::Vector2f offset;
+        sf::Vector2f position;
+        sf::Vector2f member;
+        float spread = 1.0f;
+    };
+
+    struct Formation
+    {
+        sf::Vector2f anchor;
+        sf::Vector2f heading{ 0.0f, -1.0f };
+        std::vector<Slot> slots;
+        bool arrived = false;
+    };
+
+    const FlowField& flowField;
+    const GridRaycaster& raycaster;
+    float speed;
+    std::vector<Formation> formations;
+    Stats stats;
+
+    void updateFormation(Formation& formation, float deltaSeconds);
+    void placeSlot(const Formation& formation, Slot& slot, float deltaSeconds);
+    sf::Vector2f moveAlongFlow(sf::Vector2f position, float distance) const;
+    sf::Vector2f getSlotTarget(const Formation& formation, const Slot& slot, float spread) const;
+    bool isReachable(sf::Vector2f position) const;
+    static sf::Vector2f moveTowards(sf::Vector2f position, sf::Vector2f target, float distance);
+};
+
+#endif
@@ -1,7 +1,8 @@
 #include "Game.h"
 #include <iostream>
+#include <cmath>
 
-Game::Game() :
+Game::Game(const std::string& mapPath, const std::string& cacheDirectory) :
 	window{ sf::VideoMode{ sf::Vector2u{2100, 1620U}, 32U }, "Flowfield - Cost Field" }
 {
 	// Create flowfield when game object is created
@@ -11,10 +12,21 @@ Game::Game() :
 	{
 		std::cout << "Error loading font." << std::endl;
 	}
+
+	if (!mapPath.empty() && !flowField->loadMap(mapPath))
+	{
+		std::cout << "Error loading map " << mapPath << std::endl;
+	}
+
+	if (!cacheDirectory.empty())
+	{
+		fieldCache = new FieldCache(cacheDirectory);
+	}
 }
 
 Game::~Game()
 {
+	delete fieldCache;
 	delete flowField;
 }
 
@@ -54,6 +66,15 @@ void Game::processEvents()
 		{
 			processMouseClick(newEvent);
 		}
+		if (newEvent->is<sf::Event::MouseWheelScrolled>())
+		{
+			processMouseWheel(newEvent);
+		}
+		if (const sf::Event::Resized* resized = newEvent->getIf<sf::Event::Resized>())
+		{
+			// Keep the UI at one unit per pixel, the flowfield camera adapts on its own
+			window.setView(sf::View(sf::FloatRect({ 0.0f, 0.0f }, sf::Vector2f(resized->size))));
+		}
 	}
 }
 
@@ -80,6 +101,57 @@ void Game::processKeys(const std::optional<sf::Event> t_event)
 	{
 		flowField->toggleVectorField();
 	}
+	else if (sf::Keyboard::Key::Num5 == newKeypress->code)
+	{
+		flowField->cycleUnitSize();
+	}
+	else if (sf::Keyboard::Key::Num6 == newKeypress->code)
+	{
+		flowField->toggleStats();
+	}
+	else if (sf::Keyboard::Key::Num7 == newKeypress->code)
+	{
+		if (!flowField->dumpStats("flowfield_stats.csv"))
+		{
+			std::cout << "Error writing stats file." << std::endl;
+		}
+	}
+	else if (sf::Keyboard::Key::Num8 == newKeypress->code)
+	{
+		flowField->toggleIntegrationMode();
+	}
+	else if (sf::Keyboard::Key::Num9 == newKeypress->code)
+	{
+		flowField->toggleConnectivity();
+	}
+	else if (sf::Keyboard::Key::L == newKeypress->code)
+	{
+		flowField->toggleLineOfSight();
+	}
+	else if (sf::Keyboard::Key::S == newKeypress->code)
+	{
+		flowField->toggleFieldSmoothing();
+	}
+	else if (sf::Keyboard::Key::Num0 == newKeypress->code)
+	{
+		flowField->resetCamera();
+	}
+	else if (sf::Keyboard::Key::Left == newKeypress->code)
+	{
+		flowField->panCamera({ -CAMERA_PAN_STEP, 0.0f });
+	}
+	else if (sf::Keyboard::Key::Right == newKeypress->code)
+	{
+		flowField->panCamera({ CAMERA_PAN_STEP, 0.0f });
+	}
+	else if (sf::Keyboard::Key::Up == newKeypress->code)
+	{
+		flowField->panCamera({ 0.0f, -CAMERA_PAN_STEP });
+	}
+	else if (sf::Keyboard::Key::Down == newKeypress->code)
+	{
+		flowField->panCamera({ 0.0f, CAMERA_PAN_STEP });
+	}
 	else if (sf::Keyboard::Key::Space == newKeypress->code)
 	{
 		flowField->resetNPC();
@@ -92,13 +164,28 @@ void Game::processMouseClick(const std::optional<sf::Event> t_event)
 
 	if (mousePress)
 	{
-		sf::Vector2f mousePos(static_cast<float>(mousePress->position.x),
+		sf::Vector2f screenPos(static_cast<float>(mousePress->position.x),
 			static_cast<float>(mousePress->position.y));
 
+		// Clicks on the UI panel never reach the grid
+		if (flowField->isInUI(screenPos))
+		{
+			return;
+		}
+
+		sf::Vector2f mousePos = window.mapPixelToCoords(mousePress->position, flowField->getCameraView());
+
 		// Left click: Set goal (green)
 		if (mousePress->button == sf::Mouse::Button::Left)
 		{
-			flowField->setGoal(mousePos);
+			if (fieldCache)
+			{
+				fieldCache->setGoal(*flowField, flowField->worldToGrid(mousePos));
+			}
+			else
+			{
+				flowField->setGoal(mousePos);
+			}
 		}
 		// Right click: Set start (blue)
 		else if (mousePress->button == sf::Mouse::Button::Right)
@@ -113,6 +200,20 @@ void Game::processMouseClick(const std::optional<sf::Event> t_event)
 	}
 }
 
+void Game::processMouseWheel(const std::optional<sf::Event> t_event)
+{
+	const sf::Event::MouseWheelScrolled* wheel = t_event->getIf<sf::Event::MouseWheelScrolled>();
+
+	if (wheel && wheel->wheel == sf::Mouse::Wheel::Vertical)
+	{
+		sf::Vector2f screenPos(static_cast<float>(wheel->position.x),
+			static_cast<float>(wheel->position.y));
+
+		// Scroll up zooms in, towards the cursor
+		flowField->zoomCamera(std::pow(CAMERA_ZOOM_STEP, wheel->delta), screenPos);
+	}
+}
+
 void Game::update(sf::Time t_deltaTime)
 {
 	if (exitGame)
@@ -5,11 +5,12 @@
 
 #include <SFML/Graphics.hpp>
 #include "Flowfield.h"
+#include "FieldCache.h"
 
 class Game
 {
 public:
-	Game();
+	Game(const std::string& mapPath = "", const std::string& cacheDirectory = "");
 	~Game();
 	void run();
 
@@ -17,6 +18,7 @@ private:
 	void processEvents();
 	void processKeys(const std::optional<sf::Event> t_event);
 	void processMouseClick(const std::optional<sf::Event> t_event);
+	void processMouseWheel(const std::optional<sf::Event> t_event);
 	void update(sf::Time t_deltaTime);
 	void render();
 
@@ -24,10 +26,15 @@ private:
 
 	// Flowfield instance
 	FlowField* flowField;
+	FieldCache* fieldCache = nullptr;	// Only used when a cache directory was given
 	const int GRID_WIDTH = 28;
 	const int GRID_HEIGHT = 27;
 	const float TILE_SIZE = 60.0f;
 
+	// Camera controls
+	const float CAMERA_PAN_STEP = 120.0f;	// Screen pixels per arrow key press
+	const float CAMERA_ZOOM_STEP = 1.25f;	// Zoom factor per mouse wheel notch
+
 	bool exitGame = false;
 };
 
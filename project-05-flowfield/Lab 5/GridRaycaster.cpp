@@ -0,0 +1,204 @@
+#include "GridRaycaster.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+GridRaycaster::GridRaycaster(int width, int height, const std::vector<std::uint8_t>& terrain)
+    : width(width), height(height), wordsPerRow((width + WORD_BITS - 1) / WORD_BITS)
+{
+    obstacleBits.assign(wordsPerRow * height, 0);
+    loadTerrain(terrain);
+}
+
+void GridRaycaster::loadTerrain(const std::vector<std::uint8_t>& terrain)
+{
+    if (static_cast<int>(terrain.size()) != width * height)
+        return;
+
+    std::fill(obstacleBits.begin(), obstacleBits.end(), 0);
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (terrain[y * width + x] == OBSTACLE)
+            {
+                obstacleBits[y * wordsPerRow + x / WORD_BITS] |= Word(1) << (x % WORD_BITS);
+            }
+        }
+    }
+}
+
+void GridRaycaster::setBlocked(int x, int y, bool blocked)
+{
+    if (x < 0 || x >= width || y < 0 || y >= height)
+        return;
+
+    Word bit = Word(1) << (x % WORD_BITS);
+    Word& word = obstacleBits[y * wordsPerRow + x / WORD_BITS];
+    word = blocked ? (word | bit) : (word & ~bit);
+}
+
+bool GridRaycaster::isBlocked(int x, int y) const
+{
+    if (x < 0 || x >= width || y < 0 || y >= height)
+        return true;
+
+    return (obstacleBits[y * wordsPerRow + x / WORD_BITS] >> (x % WORD_BITS)) & 1;
+}
+
+GridRaycaster::RayHit GridRaycaster::cast(sf::Vector2f from, sf::Vector2f to) const
+{
+    RayHit hit;
+    int x = static_cast<int>(std::floor(from.x));
+    int y = static_cast<int>(std::floor(from.y));
+
+    auto block = [&hit](int tileX, int tileY, double fraction)
+    {
+        hit.blocked = true;
+        hit.tile = { tileX, tileY };
+        hit.fraction = static_cast<float>(fraction);
+        return hit;
+    };
+
+    if (isBlocked(x, y))
+        return block(x, y, 0.0);
+
+    double dx = static_cast<double>(to.x) - from.x;
+    double dy = static_cast<double>(to.y) - from.y;
+    int stepX = (dx > 0.0) - (dx < 0.0);
+    int stepY = (dy > 0.0) - (dy < 0.0);
+    const double NEVER = std::numeric_limits<double>::infinity();
+
+    // Every tile boundary the ray crosses moves it one tile along x or y, so the number of
+    // crossings is known up front and the loop cannot overshoot the end tile
+    int remainingSteps = std::abs(static_cast<int>(std::floor(to.x)) - x) +
+                         std::abs(static_cast<int>(std::floor(to.y)) - y);
+
+    // Crossing times are worked out from the boundary each time instead of adding up steps, so
+    // rounding never builds up and corners between tile centres are found exactly
+    double inverseX = stepX != 0 ? 1.0 / dx : 0.0;
+    double inverseY = stepY != 0 ? 1.0 / dy : 0.0;
+
+    while (remainingSteps > 0)
+    {
+        double nextX = stepX != 0 ? (x + (stepX > 0) - static_cast<double>(from.x)) * inverseX : NEVER;
+        double nextY = stepY != 0 ? (y + (stepY > 0) - static_cast<double>(from.y)) * inverseY : NEVER;
+
+        if (std::abs(nextX - nextY) <= CORNER_EPSILON)
+        {
+            // Through a corner: both tiles beside it have to be open, as well as the one beyond
+            if (isBlocked(x + stepX, y))
+                return block(x + stepX, y, nextX);
+            if (isBlocked(x, y + stepY))
+                return block(x, y + stepY, nextX);
+
+            x += stepX;
+            y += stepY;
+            remainingSteps -= 2;
+
+            if (isBlocked(x, y))
+                return block(x, y, nextX);
+        }
+        else
+        {
+            double crossing = std::min(nextX, nextY);
+            if (nextX < nextY)
+                x += stepX;
+            else
+                y += stepY;
+            remainingSteps--;
+
+            if (isBlocked(x, y))
+                return block(x, y, crossing);
+        }
+    }
+
+    return hit;
+}
+
+bool GridRaycaster::isClear(sf::Vector2f from, sf::Vector2f to) const
+{
+    return !cast(from, to).blocked;
+}
+
+bool GridRaycaster::isClear(sf::Vector2i fromTile, sf::Vector2i toTile) const
+{
+    return isClear(sf::Vector2f(fromTile.x + 0.5f, fromTile.y + 0.5f), sf::Vector2f(toTile.x + 0.5f, toTile.y + 0.5f));
+}
+
+void GridRaycaster::castRays(const std::vector<Ray>& rays, std::vector<RayHit>& hits, int maxThreads) const
+{
+    int rayCount = static_cast<int>(rays.size());
+    hits.resize(rayCount);
+
+    int workerCount = 1;
+    if (rayCount >= PARALLEL_RAY_THRESHOLD)
+    {
+        int threadLimit = maxThreads > 0 ? maxThreads : static_cast<int>(std::thread::hardware_concurrency());
+        workerCount = std::max(1, std::min(threadLimit, rayCount / PARALLEL_RAY_THRESHOLD + 1));
+    }
+
+    auto castRange = [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            hits[i] = cast(rays[i].from, rays[i].to);
+        }
+    };
+
+    // Rays only read the grid, so each worker writes its own slice of hits and nothing is shared
+    int raysPerWorker = (rayCount + workerCount - 1) / workerCount;
+    std::vector<std::thread> workers;
+
+    for (int w = 1; w < workerCount; w++)
+    {
+        int begin = std::min(rayCount, w * raysPerWorker);
+        int end = std::min(rayCount, begin + raysPerWorker);
+        workers.emplace_back(castRange, begin, end);
+    }
+
+    castRange(0, std::min(rayCount, raysPerWorker));
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+std::vector<sf::Vector2i> GridRaycaster::smoothPath(const std::vector<sf::Vector2i>& path) const
+{
+    if (path.size() <= 2)
+        return path;
+
+    // Greedy string pulling: keep going while the last kept waypoint still sees the next tile,
+    // and keep the tile before the first one it cannot see
+    std::vector<sf::Vector2i> smoothed{ path.front() };
+
+    for (size_t i = 2; i < path.size(); i++)
+    {
+        if (!isClear(smoothed.back(), path[i]))
+        {
+            smoothed.push_back(path[i - 1]);
+        }
+    }
+
+    smoothed.push_back(path.back());
+    return smoothed;
+}
+
+size_t GridRaycaster::getMemoryUsage() const
+{
+    return obstacleBits.capacity() * sizeof(Word);
+}
+
+int GridRaycaster::getGridWidth() const
+{
+    return width;
+}
+
+int GridRaycaster::getGridHeight() const
+{
+    return height;
+}
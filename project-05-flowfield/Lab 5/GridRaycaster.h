@@ -0,0 +1,68 @@
+#ifndef GRIDRAYCASTER_HPP
+#define GRIDRAYCASTER_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+// Line of sight queries against the obstacle grid, for vision, path smoothing and cover checks.
+// Obstacles are packed one bit per tile, and rays step from tile to tile with Amanatides-Woo DDA,
+// so a ray costs one bit test per tile it crosses. Batches of rays are split across threads.
+//
+// Positions are in tiles: tile (x, y) covers [x, x + 1) x [y, y + 1), so its centre is
+// (x + 0.5, y + 0.5). A ray is blocked by any obstacle it touches, and a ray passing exactly
+// through a corner is blocked when either tile beside the corner is an obstacle, the same rule
+// that stops units cutting corners. Tiles off the grid count as obstacles.
+class GridRaycaster
+{
+public:
+    struct Ray
+    {
+        sf::Vector2f from;
+        sf::Vector2f to;
+    };
+
+    struct RayHit
+    {
+        bool blocked = false;
+        sf::Vector2i tile{ -1, -1 };    // First obstacle on the ray
+        float fraction = 1.0f;          // How far along the ray it was hit, 1 when clear
+    };
+
+    // One terrain cost per tile, row by row, 255 = obstacle
+    GridRaycaster(int width, int height, const std::vector<std::uint8_t>& terrain);
+
+    void loadTerrain(const std::vector<std::uint8_t>& terrain);
+    void setBlocked(int x, int y, bool blocked);
+    bool isBlocked(int x, int y) const;
+
+    RayHit cast(sf::Vector2f from, sf::Vector2f to) const;
+    bool isClear(sf::Vector2f from, sf::Vector2f to) const;
+    bool isClear(sf::Vector2i fromTile, sf::Vector2i toTile) const;     // Centre to centre
+
+    // One hit per ray. Batches above PARALLEL_RAY_THRESHOLD are split over up to maxThreads
+    // threads, 0 means one per hardware thread.
+    void castRays(const std::vector<Ray>& rays, std::vector<RayHit>& hits, int maxThreads = 0) const;
+
+    // Drops every waypoint the path can skip with a clear line past it, keeping both ends
+    std::vector<sf::Vector2i> smoothPath(const std::vector<sf::Vector2i>& path) const;
+
+    size_t getMemoryUsage() const;          // Bytes held by the packed obstacle bits
+    int getGridWidth() const;
+    int getGridHeight() const;
+
+private:
+    static constexpr std::uint8_t OBSTACLE = 255;
+    static constexpr int PARALLEL_RAY_THRESHOLD = 2048;     // Rays per thread before a batch is split
+    static constexpr double CORNER_EPSILON = 1e-9;          // Crossings closer than this count as a corner
+
+    using Word = std::uint64_t;
+    static constexpr int WORD_BITS = 64;
+
+    int width;
+    int height;
+    int wordsPerRow;
+    std::vector<Word> obstacleBits;         // Row by row, bit x % 64 of word x / 64
+};
+
+#endif
@@ -0,0 +1,290 @@
+#include "InfluenceMap.h"
+#include "Flowfield.h"
+#include <algorithm>
+#include <cmath>
+
+InfluenceMap::InfluenceMap(int width, int height, int radius, float decay)
+    : width(width), height(height), radius(std::max(0, radius)), decay(decay),
+      sourceStride(width + 2 * std::max(0, radius))
+{
+    kernel.resize(this->radius + 1);
+    kernel[0] = 1.0f;
+    for (int d = 1; d <= this->radius; d++)
+    {
+        kernel[d] = kernel[d - 1] * decay;
+    }
+
+    for (LayerData& layer : layers)
+    {
+        layer.sources.assign(sourceStride * height, 0.0f);
+        layer.rowBlur.assign(width * height, 0.0f);
+        layer.influence.assign(width * height, 0.0f);
+        layer.dirtySourceRows.assign(height, 0);
+        layer.changedRows.assign(height, 0);
+    }
+}
+
+int InfluenceMap::addStamp(Layer layer, sf::Vector2i tile, float strength)
+{
+    if (!isValid(tile))
+        return -1;
+
+    Stamp stamp{ layer, tile, strength, true };
+    addSource(stamp, 1.0f);
+    stats.stamps++;
+
+    if (!freeStamps.empty())
+    {
+        int index = freeStamps.back();
+        freeStamps.pop_back();
+        stamps[index] = stamp;
+        return index;
+    }
+
+    stamps.push_back(stamp);
+    return static_cast<int>(stamps.size()) - 1;
+}
+
+void InfluenceMap::moveStamp(int stamp, sf::Vector2i tile)
+{
+    if (stamp < 0 || stamp >= static_cast<int>(stamps.size()) || !stamps[stamp].active || !isValid(tile))
+        return;
+
+    if (stamps[stamp].tile == tile)
+        return;
+
+    addSource(stamps[stamp], -1.0f);
+    stamps[stamp].tile = tile;
+    addSource(stamps[stamp], 1.0f);
+}
+
+void InfluenceMap::setStampStrength(int stamp, float strength)
+{
+    if (stamp < 0 || stamp >= static_cast<int>(stamps.size()) || !stamps[stamp].active)
+        return;
+
+    addSource(stamps[stamp], -1.0f);
+    stamps[stamp].strength = strength;
+    addSource(stamps[stamp], 1.0f);
+}
+
+void InfluenceMap::removeStamp(int stamp)
+{
+    if (stamp < 0 || stamp >= static_cast<int>(stamps.size()) || !stamps[stamp].active)
+        return;
+
+    addSource(stamps[stamp], -1.0f);
+    stamps[stamp].active = false;
+    freeStamps.push_back(stamp);
+    stats.stamps--;
+}
+
+void InfluenceMap::clear()
+{
+    for (Stamp& stamp : stamps)
+    {
+        if (stamp.active)
+            addSource(stamp, -1.0f);
+    }
+
+    stamps.clear();
+    freeStamps.clear();
+    stats.stamps = 0;
+}
+
+void InfluenceMap::update()
+{
+    stats.rowsPropagated = 0;
+
+    for (LayerData& layer : layers)
+    {
+        if (!layer.dirty)
+            continue;
+
+        // Prefix counts of dirty rows, so each output row can tell whether any row within the
+        // kernel radius changed
+        std::vector<int> dirtyBefore(height + 1, 0);
+        for (int y = 0; y < height; y++)
+        {
+            if (layer.dirtySourceRows[y])
+            {
+                blurRow(layer, y);
+                stats.rowsPropagated++;
+            }
+            dirtyBefore[y + 1] = dirtyBefore[y] + layer.dirtySourceRows[y];
+        }
+
+        for (int y = 0; y < height; y++)
+        {
+            int first = std::max(0, y - radius);
+            int last = std::min(height - 1, y + radius);
+
+            if (dirtyBefore[last + 1] - dirtyBefore[first] > 0)
+            {
+                blurColumn(layer, y);
+                layer.changedRows[y] = 1;
+                stats.rowsPropagated++;
+            }
+        }
+
+        std::fill(layer.dirtySourceRows.begin(), layer.dirtySourceRows.end(), 0);
+        layer.dirty = false;
+    }
+}
+
+float InfluenceMap::getInfluence(Layer layer, int x, int y) const
+{
+    return layers[static_cast<int>(layer)].influence[y * width + x];
+}
+
+float InfluenceMap::getBalance(int x, int y) const
+{
+    return getInfluence(Layer::UNITS, x, y) - getInfluence(Layer::THREATS, x, y);
+}
+
+void InfluenceMap::applySoftCost(FlowField& flowField, Layer layer, float weight)
+{
+    stats.softCostRows = 0;
+
+    if (flowField.getGridWidth() != width || flowField.getGridHeight() != height)
+        return;
+
+    update();
+
+    LayerData& data = layers[static_cast<int>(layer)];
+
+    // A new weight changes every cost on the map
+    if (weight != data.appliedWeight)
+    {
+        std::fill(data.changedRows.begin(), data.changedRows.end(), 1);
+        data.appliedWeight = weight;
+    }
+
+    auto firstRow = std::find(data.changedRows.begin(), data.changedRows.end(), 1);
+    if (firstRow == data.changedRows.end())
+        return;
+
+    // One span from the first to the last changed row, so the field repairs everything in one go.
+    // Unchanged rows in between cost a comparison each.
+    int first = static_cast<int>(firstRow - data.changedRows.begin());
+    int last = height - 1;
+    while (!data.changedRows[last])
+    {
+        last--;
+    }
+
+    std::vector<std::uint8_t> costs((last - first + 1) * width);
+    for (int i = 0; i < static_cast<int>(costs.size()); i++)
+    {
+        float cost = weight * data.influence[first * width + i];
+        costs[i] = static_cast<std::uint8_t>(std::clamp(static_cast<int>(cost), 0, MAX_SOFT_COST));
+    }
+
+    flowField.setSoftCostRows(first, last - first + 1, costs.data());
+    std::fill(data.changedRows.begin(), data.changedRows.end(), 0);
+    stats.softCostRows = last - first + 1;
+}
+
+int InfluenceMap::getRadius() const
+{
+    return radius;
+}
+
+float InfluenceMap::getDecay() const
+{
+    return decay;
+}
+
+const InfluenceMap::Stats& InfluenceMap::getStats() const
+{
+    return stats;
+}
+
+int InfluenceMap::getGridWidth() const
+{
+    return width;
+}
+
+int InfluenceMap::getGridHeight() const
+{
+    return height;
+}
+
+void InfluenceMap::addSource(const Stamp& stamp, float sign)
+{
+    LayerData& layer = layers[static_cast<int>(stamp.layer)];
+    float& source = layer.sources[stamp.tile.y * sourceStride + radius + stamp.tile.x];
+
+    source += sign * stamp.strength;
+
+    // Stamps come and go all the time, rounding left over after the last one leaves is dropped
+    if (std::abs(source) < 1e-6f)
+        source = 0.0f;
+
+    layer.dirtySourceRows[stamp.tile.y] = 1;
+    layer.dirty = true;
+}
+
+void InfluenceMap::blurRow(LayerData& layer, int y)
+{
+    // The padding either side of each source row means no loop needs an edge check
+    const float* source = layer.sources.data() + y * sourceStride + radius;
+    float* blurred = layer.rowBlur.data() + y * width;
+
+    for (int x = 0; x < width; x++)
+    {
+        blurred[x] = kernel[0] * source[x];
+    }
+
+    for (int d = 1; d <= radius; d++)
+    {
+        float weight = kernel[d];
+        const float* left = source - d;
+        const float* right = source + d;
+
+        for (int x = 0; x < width; x++)
+        {
+            blurred[x] += weight * (left[x] + right[x]);
+        }
+    }
+}
+
+void InfluenceMap::blurColumn(LayerData& layer, int y)
+{
+    float* influence = layer.influence.data() + y * width;
+    const float* centre = layer.rowBlur.data() + y * width;
+
+    for (int x = 0; x < width; x++)
+    {
+        influence[x] = kernel[0] * centre[x];
+    }
+
+    // Rows off the map contribute nothing, so each offset is added only where it lands on the map
+    for (int d = 1; d <= radius; d++)
+    {
+        float weight = kernel[d];
+
+        if (y - d >= 0)
+        {
+            const float* above = centre - d * width;
+            for (int x = 0; x < width; x++)
+            {
+                influence[x] += weight * above[x];
+            }
+        }
+
+        if (y + d < height)
+        {
+            const float* below = centre + d * width;
+            for (int x = 0; x < width; x++)
+            {
+                influence[x] += weight * below[x];
+            }
+        }
+    }
+}
+
+bool InfluenceMap::isValid(sf::Vector2i tile) const
+{
+    return tile.x >= 0 && tile.x < width && tile.y >= 0 && tile.y < height;
+}
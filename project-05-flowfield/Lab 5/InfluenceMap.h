@@ -0,0 +1,101 @@
+#ifndef INFLUENCEMAP_HPP
+#define INFLUENCEMAP_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+class FlowField;
+
+// Influence and threat layers on the flowfield grid. Units and threats are stamped onto single
+// tiles, and each stamp spreads out with a decaying kernel, strength * decay^(|dx| + |dy|) up to
+// 'radius' tiles each way. The kernel is separable, so propagation is a horizontal blur of the
+// stamp rows followed by a vertical blur, both written as straight loops over whole rows so the
+// compiler vectorises them.
+//
+// Updates only redo rows that changed: a stamp edit dirties its row, which needs a new horizontal
+// pass, and the vertical pass redoes the rows within the radius of it. Queries read the finished
+// layer directly. Influence spreads through walls, it is a measure of presence, not of paths.
+class InfluenceMap
+{
+public:
+    enum class Layer
+    {
+        UNITS,
+        THREATS
+    };
+
+    struct Stats
+    {
+        int stamps = 0;
+        int rowsPropagated = 0;         // Horizontal and vertical rows redone by the last update
+        int softCostRows = 0;           // Rows handed to the flowfield by the last applySoftCost
+    };
+
+    InfluenceMap(int width, int height, int radius = 8, float decay = 0.75f);
+
+    // Stamps are handles, strength is the influence on the stamped tile itself
+    int addStamp(Layer layer, sf::Vector2i tile, float strength);
+    void moveStamp(int stamp, sf::Vector2i tile);
+    void setStampStrength(int stamp, float strength);
+    void removeStamp(int stamp);
+    void clear();
+
+    // Propagates every stamp change since the last update
+    void update();
+
+    float getInfluence(Layer layer, int x, int y) const;
+    float getBalance(int x, int y) const;      // Units minus threats, above zero is friendly ground
+
+    // Writes weight * influence of the layer, clamped to MAX_SOFT_COST, into the flowfield's soft
+    // cost layer. Only rows changed since the last call are written, the field repairs those tiles.
+    void applySoftCost(FlowField& flowField, Layer layer, float weight);
+
+    int getRadius() const;
+    float getDecay() const;
+    const Stats& getStats() const;
+    int getGridWidth() const;
+    int getGridHeight() const;
+
+    static constexpr int MAX_SOFT_COST = 64;
+
+private:
+    static constexpr int LAYER_COUNT = 2;
+
+    struct Stamp
+    {
+        Layer layer;
+        sf::Vector2i tile;
+        float strength;
+        bool active;
+    };
+
+    struct LayerData
+    {
+        std::vector<float> sources;         // Stamp strengths, rows padded by 'radius' zeros each side
+        std::vector<float> rowBlur;         // Sources after the horizontal pass
+        std::vector<float> influence;       // Rows after the vertical pass, what queries read
+        std::vector<std::uint8_t> dirtySourceRows;
+        std::vector<std::uint8_t> changedRows;      // Influence rows changed since applySoftCost
+        float appliedWeight = -1.0f;
+        bool dirty = false;
+    };
+
+    int width;
+    int height;
+    int radius;
+    float decay;
+    int sourceStride;                       // width + 2 * radius
+    std::vector<float> kernel;              // decay^d for d = 0 to radius
+    LayerData layers[LAYER_COUNT];
+    std::vector<Stamp> stamps;
+    std::vector<int> freeStamps;
+    Stats stats;
+
+    void addSource(const Stamp& stamp, float sign);
+    void blurRow(LayerData& layer, int y);
+    void blurColumn(LayerData& layer, int y);
+    bool isValid(sf::Vector2i tile) const;
+};
+
+#endif
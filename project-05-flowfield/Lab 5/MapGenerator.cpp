@@ -0,0 +1,316 @@
+#include "MapGenerator.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+MapGenerator::MapGenerator(unsigned int seed)
+    : rng(seed)
+{
+}
+
+std::vector<std::uint8_t> MapGenerator::generate(Family family, int width, int height, float density)
+{
+    if (width <= 0 || height <= 0 || width > MAX_SIZE || height > MAX_SIZE)
+        return {};
+
+    std::vector<std::uint8_t> terrain(static_cast<size_t>(width) * height, OPEN_TILE);
+    density = std::max(0.0f, std::min(1.0f, density));
+
+    switch (family)
+    {
+    case Family::NOISE:
+        generateNoise(terrain, density);
+        break;
+    case Family::MAZE:
+        generateMaze(terrain, width, height, density);
+        break;
+    case Family::CAVES:
+        generateCaves(terrain, width, height, density);
+        break;
+    case Family::ROOMS:
+        generateRooms(terrain, width, height, density);
+        break;
+    case Family::OPEN:
+        generateOpen(terrain, width, height, density);
+        break;
+    default:
+        break;
+    }
+
+    return terrain;
+}
+
+void MapGenerator::generateNoise(std::vector<std::uint8_t>& terrain, float density)
+{
+    // Compare raw engine output against a threshold, a float distribution per tile is noticeably
+    // slower on the largest maps
+    std::uint32_t threshold = static_cast<std::uint32_t>(density * 4294967295.0);
+
+    for (std::uint8_t& tile : terrain)
+    {
+        tile = rng() < threshold ? OBSTACLE : OPEN_TILE;
+    }
+}
+
+void MapGenerator::generateMaze(std::vector<std::uint8_t>& terrain, int width, int height, float density)
+{
+    // Recursive division: walls go on odd rows/columns and doors on even ones, so a later wall can
+    // never block an earlier door. Regions are kept on a stack instead of recursing.
+    struct Region
+    {
+        int left, top, right, bottom;   // Inclusive tile bounds
+    };
+
+    std::bernoulli_distribution secondDoor(density);
+    std::vector<Region> regions{ { 0, 0, width - 1, height - 1 } };
+
+    while (!regions.empty())
+    {
+        Region region = regions.back();
+        regions.pop_back();
+
+        int regionWidth = region.right - region.left + 1;
+        int regionHeight = region.bottom - region.top + 1;
+
+        if (regionWidth < 3 || regionHeight < 3)
+            continue;
+
+        bool horizontal = regionHeight > regionWidth || (regionHeight == regionWidth && rng() % 2 == 0);
+
+        if (horizontal)
+        {
+            int wallY = region.top + 1 + 2 * randomInt(0, (regionHeight - 3) / 2);
+            for (int x = region.left; x <= region.right; x++)
+            {
+                terrain[wallY * width + x] = OBSTACLE;
+            }
+
+            int doorCount = secondDoor(rng) ? 2 : 1;
+            for (int door = 0; door < doorCount; door++)
+            {
+                int doorX = region.left + 2 * randomInt(0, (regionWidth - 1) / 2);
+                terrain[wallY * width + doorX] = OPEN_TILE;
+            }
+
+            regions.push_back({ region.left, region.top, region.right, wallY - 1 });
+            regions.push_back({ region.left, wallY + 1, region.right, region.bottom });
+        }
+        else
+        {
+            int wallX = region.left + 1 + 2 * randomInt(0, (regionWidth - 3) / 2);
+            for (int y = region.top; y <= region.bottom; y++)
+            {
+                terrain[y * width + wallX] = OBSTACLE;
+            }
+
+            int doorCount = secondDoor(rng) ? 2 : 1;
+            for (int door = 0; door < doorCount; door++)
+            {
+                int doorY = region.top + 2 * randomInt(0, (regionHeight - 1) / 2);
+                terrain[doorY * width + wallX] = OPEN_TILE;
+            }
+
+            regions.push_back({ region.left, region.top, wallX - 1, region.bottom });
+            regions.push_back({ wallX + 1, region.top, region.right, region.bottom });
+        }
+    }
+}
+
+void MapGenerator::generateCaves(std::vector<std::uint8_t>& terrain, int width, int height, float density)
+{
+    generateNoise(terrain, density);
+
+    // 4-5 rule: a tile becomes rock when at least five of the nine tiles around it (itself included)
+    // are rock. Tiles off the map count as rock so caves close off at the edges.
+    std::vector<std::uint8_t> next(terrain.size());
+    std::vector<int> columnRock(width + 2);
+
+    auto isRock = [&](int x, int y)
+    {
+        return x < 0 || x >= width || y < 0 || y >= height || terrain[y * width + x] == OBSTACLE ? 1 : 0;
+    };
+
+    for (int iteration = 0; iteration < CAVE_ITERATIONS; iteration++)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            // Rock count of each 3 tall column around this row, then slide a 3 wide window over it
+            for (int x = -1; x <= width; x++)
+            {
+                columnRock[x + 1] = isRock(x, y - 1) + isRock(x, y) + isRock(x, y + 1);
+            }
+
+            for (int x = 0; x < width; x++)
+            {
+                int rock = columnRock[x] + columnRock[x + 1] + columnRock[x + 2];
+                next[y * width + x] = rock >= 5 ? OBSTACLE : OPEN_TILE;
+            }
+        }
+
+        terrain.swap(next);
+    }
+}
+
+void MapGenerator::generateRooms(std::vector<std::uint8_t>& terrain, int width, int height, float density)
+{
+    std::fill(terrain.begin(), terrain.end(), OBSTACLE);
+
+    // At most one room per cell keeps placement and corridor lengths linear in the map size
+    const int cellSize = MAX_ROOM_SIZE + 2;
+    const float averageRoomSide = (MIN_ROOM_SIZE + MAX_ROOM_SIZE) / 2.0f;
+    std::bernoulli_distribution placeRoom(std::min(1.0f, density * cellSize * cellSize / (averageRoomSide * averageRoomSide)));
+    std::bernoulli_distribution extraCorridor(0.25);
+
+    auto carve = [&](int x, int y)
+    {
+        terrain[y * width + x] = OPEN_TILE;
+    };
+
+    // Horizontal then vertical leg, or the other way round
+    auto carveCorridor = [&](int fromX, int fromY, int toX, int toY)
+    {
+        bool horizontalFirst = rng() % 2 == 0;
+        int cornerX = horizontalFirst ? toX : fromX;
+        int cornerY = horizontalFirst ? fromY : toY;
+
+        for (int x = std::min(fromX, cornerX); x <= std::max(fromX, cornerX); x++) carve(x, fromY);
+        for (int y = std::min(fromY, cornerY); y <= std::max(fromY, cornerY); y++) carve(fromX, y);
+        for (int x = std::min(cornerX, toX); x <= std::max(cornerX, toX); x++) carve(x, toY);
+        for (int y = std::min(cornerY, toY); y <= std::max(cornerY, toY); y++) carve(toX, y);
+    };
+
+    int cellColumns = (width + cellSize - 1) / cellSize;
+    std::vector<int> roomAbove(cellColumns, -1);        // Centre index of the room in the cell above
+    int previousRoom = -1;
+
+    for (int cellY = 0; cellY < height; cellY += cellSize)
+    {
+        for (int cellX = 0; cellX < width; cellX += cellSize)
+        {
+            int column = cellX / cellSize;
+            int maxWidth = std::min(cellSize, width - cellX) - 2;
+            int maxHeight = std::min(cellSize, height - cellY) - 2;
+
+            if (maxWidth < 2 || maxHeight < 2 || !placeRoom(rng))
+            {
+                roomAbove[column] = -1;
+                continue;
+            }
+
+            int roomWidth = randomInt(std::min(MIN_ROOM_SIZE, maxWidth), maxWidth);
+            int roomHeight = randomInt(std::min(MIN_ROOM_SIZE, maxHeight), maxHeight);
+            int left = cellX + 1 + randomInt(0, maxWidth - roomWidth);
+            int top = cellY + 1 + randomInt(0, maxHeight - roomHeight);
+
+            for (int y = top; y < top + roomHeight; y++)
+            {
+                for (int x = left; x < left + roomWidth; x++)
+                {
+                    carve(x, y);
+                }
+            }
+
+            // Chaining every room to the one placed before it keeps the whole map connected,
+            // a few extra links to the room above add loops
+            int centreX = left + roomWidth / 2;
+            int centreY = top + roomHeight / 2;
+
+            if (previousRoom >= 0)
+            {
+                carveCorridor(centreX, centreY, previousRoom % width, previousRoom / width);
+            }
+            if (roomAbove[column] >= 0 && extraCorridor(rng))
+            {
+                carveCorridor(centreX, centreY, roomAbove[column] % width, roomAbove[column] / width);
+            }
+
+            previousRoom = centreY * width + centreX;
+            roomAbove[column] = previousRoom;
+        }
+    }
+}
+
+void MapGenerator::generateOpen(std::vector<std::uint8_t>& terrain, int width, int height, float density)
+{
+    // Blocks of 1x1 to 3x3 tiles, 4 tiles on average
+    long long blockCount = static_cast<long long>(density * width * height / 4.0f);
+
+    for (long long block = 0; block < blockCount; block++)
+    {
+        int blockWidth = randomInt(1, 3);
+        int blockHeight = randomInt(1, 3);
+        int left = randomInt(0, width - 1);
+        int top = randomInt(0, height - 1);
+
+        for (int y = top; y < std::min(height, top + blockHeight); y++)
+        {
+            for (int x = left; x < std::min(width, left + blockWidth); x++)
+            {
+                terrain[y * width + x] = OBSTACLE;
+            }
+        }
+    }
+}
+
+int MapGenerator::randomInt(int min, int max)
+{
+    return std::uniform_int_distribution<int>(min, max)(rng);
+}
+
+const char* MapGenerator::getFamilyName(Family family)
+{
+    switch (family)
+    {
+    case Family::NOISE: return "noise";
+    case Family::MAZE:  return "maze";
+    case Family::CAVES: return "caves";
+    case Family::ROOMS: return "rooms";
+    case Family::OPEN:  return "open";
+    default:            return "unknown";
+    }
+}
+
+bool MapGenerator::parseFamily(const std::string& name, Family& family)
+{
+    for (int i = 0; i < static_cast<int>(Family::COUNT); i++)
+    {
+        if (name == getFamilyName(static_cast<Family>(i)))
+        {
+            family = static_cast<Family>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MapGenerator::writeMap(const std::string& path, int width, int height, const std::vector<std::uint8_t>& terrain)
+{
+    if (terrain.size() != static_cast<size_t>(width) * height)
+        return false;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    file << "FFMAP 1\n" << width << ' ' << height << '\n';
+    file.write(reinterpret_cast<const char*>(terrain.data()), terrain.size());
+    return static_cast<bool>(file);
+}
+
+bool MapGenerator::readMap(const std::string& path, int& width, int& height, std::vector<std::uint8_t>& terrain)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string magic;
+    std::string sizeLine;
+
+    if (!std::getline(file, magic) || magic != "FFMAP 1" || !std::getline(file, sizeLine))
+        return false;
+
+    std::istringstream size(sizeLine);
+    if (!(size >> width >> height) || width <= 0 || height <= 0 || width > MAX_SIZE || height > MAX_SIZE)
+        return false;
+
+    terrain.resize(static_cast<size_t>(width) * height);
+    file.read(reinterpret_cast<char*>(terrain.data()), terrain.size());
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,55 @@
+#ifndef MAPGENERATOR_HPP
+#define MAPGENERATOR_HPP
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Seeded procedural terrain for benchmarks and tests. Maps are one terrain cost byte per tile,
+// row by row, using the same 1 = open / 255 = obstacle convention as FlowField.
+class MapGenerator
+{
+public:
+    enum class Family
+    {
+        NOISE,      // Independent obstacles, density = obstacle chance per tile
+        MAZE,       // Recursive division, density = chance of a second door in each wall
+        CAVES,      // Cellular automaton caves, density = initial fill chance (around 0.45)
+        ROOMS,      // Rooms joined by corridors, density = share of the map covered by rooms
+        OPEN,       // Open field with small scattered blocks, density = share of blocked tiles
+        COUNT
+    };
+
+    static constexpr std::uint8_t OPEN_TILE = 1;
+    static constexpr std::uint8_t OBSTACLE = 255;
+    static constexpr int MAX_SIZE = 16384;
+
+    explicit MapGenerator(unsigned int seed = 1);
+
+    // Empty result when the size is out of range
+    std::vector<std::uint8_t> generate(Family family, int width, int height, float density);
+
+    static const char* getFamilyName(Family family);
+    static bool parseFamily(const std::string& name, Family& family);
+
+    // Map files: a "FFMAP 1" line, a "width height" line, then width * height raw terrain bytes
+    static bool writeMap(const std::string& path, int width, int height, const std::vector<std::uint8_t>& terrain);
+    static bool readMap(const std::string& path, int& width, int& height, std::vector<std::uint8_t>& terrain);
+
+private:
+    static constexpr int CAVE_ITERATIONS = 5;
+    static constexpr int MIN_ROOM_SIZE = 4;
+    static constexpr int MAX_ROOM_SIZE = 24;
+
+    std::mt19937 rng;
+
+    void generateNoise(std::vector<std::uint8_t>& terrain, float density);
+    void generateMaze(std::vector<std::uint8_t>& terrain, int width, int height, float density);
+    void generateCaves(std::vector<std::uint8_t>& terrain, int width, int height, float density);
+    void generateRooms(std::vector<std::uint8_t>& terrain, int width, int height, float density);
+    void generateOpen(std::vector<std::uint8_t>& terrain, int width, int height, float density);
+    int randomInt(int min, int max);
+};
+
+#endif
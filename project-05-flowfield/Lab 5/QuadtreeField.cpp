@@ -0,0 +1,290 @@
+#include "QuadtreeField.h"
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+
+QuadtreeField::QuadtreeField(int width, int height, const std::vector<std::uint8_t>& terrain)
+    : width(width), height(height)
+{
+    while (rootSize < width || rootSize < height)
+    {
+        rootSize *= 2;
+    }
+
+    nodes.push_back(0);
+    buildNode(0, terrain, 0, 0, rootSize);
+    createPortals();
+
+    nodes.shrink_to_fit();
+    leaves.shrink_to_fit();
+    portals.shrink_to_fit();
+    leafCosts.assign(leaves.size(), -1);
+    parentPortals.assign(leaves.size(), -1);
+
+    stats.nodes = static_cast<int>(nodes.size());
+    stats.leaves = static_cast<int>(leaves.size());
+    stats.openLeaves = static_cast<int>(std::count_if(leaves.begin(), leaves.end(),
+                                                      [](const Leaf& leaf) { return leaf.open; }));
+    stats.portals = static_cast<int>(portals.size());
+}
+
+bool QuadtreeField::setGoalTile(sf::Vector2i goal)
+{
+    int leafIndex = findLeaf(goal.x, goal.y);
+    if (leafIndex < 0 || !leaves[leafIndex].open)
+        return false;
+
+    goalPosition = goal;
+    goalLeaf = leafIndex;
+    stats.leavesVisited = 0;
+
+    std::fill(leafCosts.begin(), leafCosts.end(), -1);
+    std::fill(parentPortals.begin(), parentPortals.end(), -1);
+
+    // Dijkstra over whole blocks. Each step walks from the centre of a leaf to the middle of a shared
+    // edge, across it, and on to the neighbour's centre, all in a straight line through open blocks.
+    using QueueEntry = std::pair<int, int>;         // (cost, leaf)
+    std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> openLeaves;
+    leafCosts[goalLeaf] = 0;
+    openLeaves.push({ 0, goalLeaf });
+
+    while (!openLeaves.empty())
+    {
+        auto [currentCost, current] = openLeaves.top();
+        openLeaves.pop();
+
+        if (leafCosts[current] != currentCost)
+            continue;
+
+        stats.leavesVisited++;
+        sf::Vector2i centre = getCentreTile(current);
+
+        for (int portal = leaves[current].firstPortal; portal < getPortalEnd(current); portal++)
+        {
+            const Portal& crossing = portals[portal];
+            int neighbour = crossing.leaf;
+
+            int newCost = currentCost + chebyshev(centre, crossing.getExit()) + 1 +
+                          chebyshev(crossing.getEntry(), getCentreTile(neighbour));
+
+            if (leafCosts[neighbour] == -1 || newCost < leafCosts[neighbour])
+            {
+                leafCosts[neighbour] = newCost;
+                parentPortals[neighbour] = portal;
+                openLeaves.push({ newCost, neighbour });
+            }
+        }
+    }
+
+    return true;
+}
+
+int QuadtreeField::getCost(int x, int y) const
+{
+    int leafIndex = findLeaf(x, y);
+    if (leafIndex < 0 || leafCosts[leafIndex] < 0)
+        return -1;
+
+    return leafCosts[leafIndex] + chebyshev(sf::Vector2i(x, y), getCentreTile(leafIndex));
+}
+
+sf::Vector2i QuadtreeField::getFlowDirection(int x, int y) const
+{
+    int leafIndex = findLeaf(x, y);
+    if (leafIndex < 0 || leafCosts[leafIndex] < 0)
+        return { 0, 0 };
+
+    // Head for the goal inside its own leaf, otherwise for the portal out of the leaf. Leaves are
+    // open rectangles, so the straight steps there never touch an obstacle.
+    sf::Vector2i tile(x, y);
+    sf::Vector2i target = goalPosition;
+
+    if (leafIndex != goalLeaf)
+    {
+        const Portal& crossing = portals[parentPortals[leafIndex]];
+        if (tile == crossing.getEntry())
+            return crossing.getExit() - crossing.getEntry();
+
+        target = crossing.getEntry();
+    }
+
+    sf::Vector2i offset = target - tile;
+    return sf::Vector2i((offset.x > 0) - (offset.x < 0), (offset.y > 0) - (offset.y < 0));
+}
+
+int QuadtreeField::getBlockSize(int x, int y) const
+{
+    int leafIndex = findLeaf(x, y);
+    return leafIndex >= 0 ? leaves[leafIndex].size : 0;
+}
+
+size_t QuadtreeField::getMemoryUsage() const
+{
+    return nodes.capacity() * sizeof(int) + leaves.capacity() * sizeof(Leaf) + portals.capacity() * sizeof(Portal) +
+           (leafCosts.capacity() + parentPortals.capacity()) * sizeof(int);
+}
+
+const QuadtreeField::Stats& QuadtreeField::getStats() const
+{
+    return stats;
+}
+
+int QuadtreeField::getGridWidth() const
+{
+    return width;
+}
+
+int QuadtreeField::getGridHeight() const
+{
+    return height;
+}
+
+void QuadtreeField::buildNode(int node, const std::vector<std::uint8_t>& terrain, int x, int y, int size)
+{
+    // Tiles past the map edge count as obstacles, so blocks sticking out of the map always split
+    auto isOpen = [&](int tileX, int tileY)
+    {
+        return tileX < width && tileY < height && terrain[tileY * width + tileX] != OBSTACLE;
+    };
+
+    bool open = isOpen(x, y);
+    bool uniform = true;
+
+    for (int tileY = y; tileY < y + size && uniform; tileY++)
+    {
+        for (int tileX = x; tileX < x + size; tileX++)
+        {
+            if (isOpen(tileX, tileY) != open)
+            {
+                uniform = false;
+                break;
+            }
+        }
+    }
+
+    if (uniform)
+    {
+        nodes[node] = -(static_cast<int>(leaves.size()) + 1);
+
+        Leaf leaf;
+        leaf.x = static_cast<std::uint16_t>(x);
+        leaf.y = static_cast<std::uint16_t>(y);
+        leaf.size = static_cast<std::uint16_t>(size);
+        leaf.open = open;
+        leaves.push_back(leaf);
+        return;
+    }
+
+    int firstChild = static_cast<int>(nodes.size());
+    nodes.resize(nodes.size() + 4);
+    nodes[node] = firstChild;
+
+    int half = size / 2;
+    for (int quadrant = 0; quadrant < 4; quadrant++)
+    {
+        buildNode(firstChild + quadrant, terrain, x + (quadrant % 2) * half, y + (quadrant / 2) * half, half);
+    }
+}
+
+void QuadtreeField::createPortals()
+{
+    // Walk just outside each side of every open leaf, one neighbouring leaf at a time. Diagonal
+    // neighbours need no portals: two open leaves that only touch at a corner are either joined
+    // through a third open leaf or cut off by obstacles on both sides of the corner.
+    for (int leafIndex = 0; leafIndex < static_cast<int>(leaves.size()); leafIndex++)
+    {
+        Leaf& leaf = leaves[leafIndex];
+        leaf.firstPortal = static_cast<int>(portals.size());
+
+        if (!leaf.open)
+            continue;
+
+        for (int side = 0; side < 4; side++)
+        {
+            bool vertical = SIDE_DY[side] != 0;
+            int step = SIDE_DX[side] + SIDE_DY[side];
+
+            // Row or column just outside this side
+            int outside = vertical ? (step < 0 ? leaf.y - 1 : leaf.y + leaf.size)
+                                   : (step < 0 ? leaf.x - 1 : leaf.x + leaf.size);
+            int inside = outside - step;
+
+            if (outside < 0 || outside >= (vertical ? height : width))
+                continue;
+
+            int start = vertical ? leaf.x : leaf.y;
+            int end = start + leaf.size;
+
+            for (int position = start; position < end;)
+            {
+                int neighbourIndex = vertical ? findLeaf(position, outside) : findLeaf(outside, position);
+                const Leaf& neighbour = leaves[neighbourIndex];
+                int sharedEnd = std::min(end, (vertical ? neighbour.x : neighbour.y) + neighbour.size);
+
+                if (neighbour.open)
+                {
+                    int middle = (position + sharedEnd - 1) / 2;
+                    Portal portal;
+                    portal.leaf = neighbourIndex;
+                    portal.exitX = static_cast<std::uint16_t>(vertical ? middle : inside);
+                    portal.exitY = static_cast<std::uint16_t>(vertical ? inside : middle);
+                    portal.side = static_cast<std::uint8_t>(side);
+                    portals.push_back(portal);
+                }
+
+                position = sharedEnd;
+            }
+        }
+    }
+}
+
+int QuadtreeField::findLeaf(int x, int y) const
+{
+    if (x < 0 || x >= width || y < 0 || y >= height)
+        return -1;
+
+    int node = 0;
+    int nodeX = 0;
+    int nodeY = 0;
+    int size = rootSize;
+
+    while (nodes[node] >= 0)
+    {
+        size /= 2;
+        int quadrant = (x >= nodeX + size) + 2 * (y >= nodeY + size);
+        nodeX += (quadrant % 2) * size;
+        nodeY += (quadrant / 2) * size;
+        node = nodes[node] + quadrant;
+    }
+
+    return -nodes[node] - 1;
+}
+
+int QuadtreeField::getPortalEnd(int leaf) const
+{
+    return leaf + 1 < static_cast<int>(leaves.size()) ? leaves[leaf + 1].firstPortal : static_cast<int>(portals.size());
+}
+
+sf::Vector2i QuadtreeField::getCentreTile(int leaf) const
+{
+    // The goal stands in for the centre of its own leaf
+    if (leaf == goalLeaf)
+        return goalPosition;
+
+    return sf::Vector2i(leaves[leaf].x + leaves[leaf].size / 2, leaves[leaf].y + leaves[leaf].size / 2);
+}
+
+sf::Vector2i QuadtreeField::Portal::getExit() const
+{
+    return sf::Vector2i(exitX, exitY);
+}
+
+sf::Vector2i QuadtreeField::Portal::getEntry() const
+{
+    return sf::Vector2i(exitX + SIDE_DX[side], exitY + SIDE_DY[side]);
+}
+
+int QuadtreeField::chebyshev(sf::Vector2i a, sf::Vector2i b)
+{
+    return std::max(std::abs(a.x - b.x), std::abs(a.y - b.y));
+}
@@ -0,0 +1,96 @@
+#ifndef QUADTREEFIELD_HPP
+#define QUADTREEFIELD_HPP
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+// Sparse field for mostly open maps. The terrain is split into a region quadtree whose leaves are
+// uniform blocks, either all open or all obstacle, so big open areas are a single leaf and detail
+// only builds up around obstacles. The field is a Dijkstra over the open leaves rather than tiles:
+// each leaf stores one cost, the length of a real route from its centre tile to the goal that
+// crosses each block border at the middle of the shared edge.
+//
+// A tile's cost is then bounded analytically as the leaf cost plus the Chebyshev distance to the
+// leaf centre. It is never below the true path distance, and following the flow directions never
+// takes longer than it. Memory and sweep time grow with the number of leaves, not the map area.
+// Movement matches FlowField with unit size 1: eight neighbours, no cutting obstacle corners.
+class QuadtreeField
+{
+public:
+    struct Stats
+    {
+        int nodes = 0;
+        int leaves = 0;
+        int openLeaves = 0;
+        int portals = 0;                // Shared edges between open leaves, counted from both sides
+        int leavesVisited = 0;          // By the last setGoalTile
+    };
+
+    // One terrain cost per tile, row by row, 255 = obstacle
+    QuadtreeField(int width, int height, const std::vector<std::uint8_t>& terrain);
+
+    bool setGoalTile(sf::Vector2i goal);
+
+    // -1 when the tile is blocked or cannot reach the goal
+    int getCost(int x, int y) const;
+    sf::Vector2i getFlowDirection(int x, int y) const;
+
+    int getBlockSize(int x, int y) const;   // Side of the leaf holding the tile
+    size_t getMemoryUsage() const;          // Bytes held by the tree, leaves and portals
+    const Stats& getStats() const;
+    int getGridWidth() const;
+    int getGridHeight() const;
+
+private:
+    static constexpr std::uint8_t OBSTACLE = 255;
+
+    // Sides in portal order, the crossing goes one tile this way
+    static constexpr int SIDE_DX[4] = { 0, 0, -1, 1 };
+    static constexpr int SIDE_DY[4] = { -1, 1, 0, 0 };
+
+    // Coordinates fit in 16 bits, maps are at most MapGenerator::MAX_SIZE tiles across
+    struct Leaf
+    {
+        std::uint16_t x;
+        std::uint16_t y;
+        std::uint16_t size;
+        bool open;
+        int firstPortal = 0;            // Portals of this leaf are firstPortal to the next leaf's
+    };
+
+    // Crossing from one open leaf into a neighbouring one, at the middle of their shared edge
+    struct Portal
+    {
+        int leaf;                       // Leaf on the other side
+        std::uint16_t exitX;            // Last tile on this side
+        std::uint16_t exitY;
+        std::uint8_t side;
+
+        sf::Vector2i getExit() const;
+        sf::Vector2i getEntry() const;  // First tile on the other side
+    };
+
+    int width;
+    int height;
+    int rootSize = 1;
+    sf::Vector2i goalPosition{ -1, -1 };
+    int goalLeaf = -1;
+    std::vector<int> nodes;             // First of four children, or -(leaf + 1) for leaves
+    std::vector<Leaf> leaves;
+    std::vector<Portal> portals;
+    Stats stats;
+
+    // Field for the current goal, one entry per leaf
+    std::vector<int> leafCosts;
+    std::vector<int> parentPortals;     // Portal from the leaf nearer the goal into this one
+
+    void buildNode(int node, const std::vector<std::uint8_t>& terrain, int x, int y, int size);
+    void createPortals();
+    int findLeaf(int x, int y) const;
+    int getPortalEnd(int leaf) const;
+    sf::Vector2i getCentreTile(int leaf) const;
+    static int chebyshev(sf::Vector2i a, sf::Vector2i b);
+};
+
+#endif
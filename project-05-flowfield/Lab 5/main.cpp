@@ -13,11 +13,68 @@
 #endif 
 
 #include <iostream>
+#include <string>
 #include "Game.h"
+#include "FlowFieldValidator.h"
+#include "MapGenerator.h"
 
-int main()
+int main(int argc, char* argv[])
 {
-	Game game;
+	// Headless modes: "--validate [mapCount]" checks fields on random maps,
+	// "--benchmark [baselineFile]" times each stage against stored baselines
+	if (argc > 1 && std::string(argv[1]) == "--validate")
+	{
+		FlowFieldValidator validator;
+		int mapCount = argc > 2 ? std::stoi(argv[2]) : 60;
+		return validator.runCorrectness(mapCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	if (argc > 1 && std::string(argv[1]) == "--benchmark")
+	{
+		FlowFieldValidator validator;
+		std::string baselinePath = argc > 2 ? argv[2] : "flowfield_baseline.csv";
+		return validator.runBenchmark(baselinePath) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	// "--generate <family> <width> <height> <density> <seed> <file>" writes a benchmark map
+	if (argc > 1 && std::string(argv[1]) == "--generate")
+	{
+		MapGenerator::Family family;
+		if (argc < 8 || !MapGenerator::parseFamily(argv[2], family))
+		{
+			std::cout << "Usage: --generate <noise|maze|caves|rooms|open> <width> <height> <density> <seed> <file>" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		int width = std::stoi(argv[3]);
+		int height = std::stoi(argv[4]);
+		MapGenerator generator(static_cast<unsigned int>(std::stoul(argv[6])));
+		std::vector<std::uint8_t> terrain = generator.generate(family, width, height, std::stof(argv[5]));
+
+		if (terrain.empty() || !MapGenerator::writeMap(argv[7], width, height, terrain))
+		{
+			std::cout << "Error generating map " << argv[7] << std::endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	// "--map <file>" starts on a generated map, "--cache <directory>" keeps generated fields on
+	// disk between runs
+	std::string mapPath;
+	std::string cacheDirectory;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		if (std::string(argv[i]) == "--map")
+		{
+			mapPath = argv[i + 1];
+		}
+		else if (std::string(argv[i]) == "--cache")
+		{
+			cacheDirectory = argv[i + 1];
+		}
+	}
+
+	Game game(mapPath, cacheDirectory);
 	game.run();
 	
 	return EXIT_SUCCESS;